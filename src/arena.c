@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "log.h"
+
+#define ARENA_ALIGN 16
+
+void arenaInit(Arena* arena, size_t blockSize) {
+    arena->head = NULL;
+    arena->blockSize = blockSize ? blockSize : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->bytesUsed = 0;
+    arena->bytesReserved = 0;
+    arena->blockCount = 0;
+    arena->allocCount = 0;
+}
+
+static ArenaBlock* newBlock(Arena* arena, size_t size) {
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        logError("Memory allocation failed for arena block");
+        return NULL;
+    }
+    block->size = size;
+    block->used = 0;
+    arena->bytesReserved += size;
+    arena->blockCount++;
+    return block;
+}
+
+// Bump-pointer allocation. Requests larger than a quarter of a block get
+// a dedicated block linked behind the current one, so the partly filled
+// block keeps serving small allocations.
+void* arenaAlloc(Arena* arena, size_t size) {
+    if (arena->blockSize == 0) {
+        arenaInit(arena, 0);
+    }
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena->allocCount++;
+
+    if (size > arena->blockSize / 4) {
+        ArenaBlock* big = newBlock(arena, size);
+        if (!big) return NULL;
+        big->used = size;
+        if (arena->head) {
+            big->next = arena->head->next;
+            arena->head->next = big;
+        } else {
+            big->next = NULL;
+            arena->head = big;
+        }
+        arena->bytesUsed += size;
+        return big->data;
+    }
+
+    ArenaBlock* block = arena->head;
+    if (!block || block->size - block->used < size) {
+        block = newBlock(arena, arena->blockSize);
+        if (!block) return NULL;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void* p = block->data + block->used;
+    block->used += size;
+    arena->bytesUsed += size;
+    return p;
+}
+
+char* arenaStrdup(Arena* arena, const char* s) {
+    size_t len = strlen(s) + 1;
+    char* copy = arenaAlloc(arena, len);
+    if (copy) memcpy(copy, s, len);
+    return copy;
+}
+
+// Empties the arena but keeps one regular block, so an arena that is
+// reused for many small documents stops calling malloc once warm.
+void arenaReset(Arena* arena) {
+    ArenaBlock* keep = NULL;
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        if (!keep && block->size == arena->blockSize) {
+            keep = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    arenaInit(arena, arena->blockSize);
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+        arena->head = keep;
+        arena->bytesReserved = keep->size;
+        arena->blockCount = 1;
+    }
+}
+
+void arenaFree(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arenaInit(arena, arena->blockSize);
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1 << 20)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;        // Usable bytes in data
+    size_t used;        // Bytes handed out from data
+    _Alignas(16) char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;   // Block currently being filled
+    size_t blockSize;   // Size of regular blocks
+    size_t bytesUsed;   // Total bytes handed out
+    size_t bytesReserved; // Total bytes obtained from malloc
+    size_t blockCount;  // Number of blocks allocated
+    size_t allocCount;  // Number of arenaAlloc() calls
+} Arena;
+
+void arenaInit(Arena* arena, size_t blockSize);
+void* arenaAlloc(Arena* arena, size_t size);
+char* arenaStrdup(Arena* arena, const char* s);
+void arenaReset(Arena* arena);
+void arenaFree(Arena* arena);
+
+#endif
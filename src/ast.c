@@ -3,45 +3,62 @@
 #include <stdlib.h>
 #include "ast.h"
 
-ASTNode* createNode(const char* type) {
-    ASTNode* node = malloc(sizeof(ASTNode));
-    node->type = strdup(type);
-    node->strVal = NULL;
-    node->intVal = 0;
+// Names printed by printAST() and used in diagnostics, indexed by NodeKind.
+const char* const nodeKindNames[NODE_KIND_COUNT] = {
+    [NODE_OBJECT] = "object",
+    [NODE_EMPTY_OBJECT] = "empty_object",
+    [NODE_MEMBERS] = "members",
+    [NODE_PAIR] = "pair",
+    [NODE_ARRAY] = "array",
+    [NODE_ELEMENTS] = "elements",
+    [NODE_STRING] = "string",
+    [NODE_NUMBER] = "number",
+    [NODE_BOOL] = "bool",
+    [NODE_NULL] = "null",
+};
+
+// Every node and children array lives in the arena of its parse and is
+// released at once with it when the conversion is done.
+ASTNode* createNode(Arena* arena, NodeKind kind) {
+    ASTNode* node = arenaAlloc(arena, sizeof(ASTNode));
+    node->kind = kind;
+    node->strVal.ptr = NULL;
+    node->strVal.len = 0;
+    node->strVal.flags = 0;
+    node->keyId = -1;
     node->boolVal = 0;
-    node->hasInt = 0;
-    node->hasBool = 0;
     node->childCount = 0;
-    node->childCapacity = 4;
-    node->children = malloc(sizeof(ASTNode*) * node->childCapacity);
+    node->childCapacity = 0;
+    node->children = NULL;
+    node->parent = NULL;
     return node;
 }
 
-void addChild(ASTNode* parent, ASTNode* child) {
+void addChild(Arena* arena, ASTNode* parent, ASTNode* child) {
     if (parent->childCount >= parent->childCapacity) {
-        parent->childCapacity *= 2;
-        parent->children = realloc(parent->children, sizeof(ASTNode*) * parent->childCapacity);
+        // Arena memory cannot be resized, so the old array stays behind
+        // until the arena is freed; doubling keeps that waste below the
+        // final size.
+        int newCapacity = parent->childCapacity ? parent->childCapacity * 2 : 4;
+        ASTNode** children = arenaAlloc(arena, sizeof(ASTNode*) * newCapacity);
+        if (parent->childCount) {
+            memcpy(children, parent->children, sizeof(ASTNode*) * parent->childCount);
+        }
+        parent->children = children;
+        parent->childCapacity = newCapacity;
     }
     parent->children[parent->childCount++] = child;
 }
 
-ASTNode* createStrNode(const char* type, char* val) {
-    ASTNode* node = createNode(type);
-    node->strVal = strdup(val);
+ASTNode* createStrNode(Arena* arena, NodeKind kind, Slice val) {
+    ASTNode* node = createNode(arena, kind);
+    node->strVal = val;
     return node;
 }
 
-ASTNode* createIntNode(const char* type, int val) {
-    ASTNode* node = createNode(type);
-    node->intVal = val;
-    node->hasInt = 1;
-    return node;
-}
-
-ASTNode* createBoolNode(const char* type, int val) {
-    ASTNode* node = createNode(type);
+ASTNode* createBoolNode(Arena* arena, NodeKind kind, int val) {
+    ASTNode* node = createNode(arena, kind);
     node->boolVal = val;
-    node->hasBool = 1;
     return node;
 }
 
@@ -56,17 +73,26 @@ void printAST(ASTNode* node, int indent, int isLast) {
         printf(isLast ? "└── " : "├── ");
     }
 
-    printf("Type: %s", node->type);
-    if (node->strVal) printf(", StrVal: %s", node->strVal);
-    if (node->hasInt) printf(", IntVal: %d", node->intVal);
-    if (node->hasBool) printf(", BoolVal: %s", node->boolVal ? "true" : "false");
+    printf("Type: %s", nodeKindName(node->kind));
+    if (node->kind == NODE_NUMBER) {
+        printf(", NumVal: %.*s", (int)node->strVal.len, node->strVal.ptr);
+    } else if (node->strVal.ptr) {
+        printf(", StrVal: %.*s", (int)node->strVal.len, node->strVal.ptr);
+    }
+    if (node->kind == NODE_BOOL) printf(", BoolVal: %s", node->boolVal ? "true" : "false");
     printf("\n");
 
     for (int i = 0; i < node->childCount; i++) {
         int isLastChild = (i == node->childCount - 1);
         printAST(node->children[i], indent + 1, isLastChild);
     }
+}
 
-
-    
+size_t countNodes(const ASTNode* node) {
+    if (!node) return 0;
+    size_t count = 1;
+    for (int i = 0; i < node->childCount; i++) {
+        count += countNodes(node->children[i]);
+    }
+    return count;
 }
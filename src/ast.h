@@ -1,24 +1,45 @@
 #ifndef AST_H
 #define AST_H
 
+#include "slice.h"
+#include "arena.h"
+
+typedef enum {
+    NODE_OBJECT,
+    NODE_EMPTY_OBJECT,
+    NODE_MEMBERS,
+    NODE_PAIR,
+    NODE_ARRAY,
+    NODE_ELEMENTS,
+    NODE_STRING,
+    NODE_NUMBER,
+    NODE_BOOL,
+    NODE_NULL,
+    NODE_KIND_COUNT
+} NodeKind;
+
+extern const char* const nodeKindNames[NODE_KIND_COUNT];
+
+static inline const char* nodeKindName(NodeKind kind) {
+    return (unsigned)kind < NODE_KIND_COUNT ? nodeKindNames[kind] : "unknown";
+}
+
 typedef struct ASTNode {
-    char* type;
-    char* strVal;
-    int intVal;
+    NodeKind kind;
+    Slice strVal;       // Key of a pair, value of a string or text of a number; points into the input
+    int keyId;          // Interned id of a pair's key, -1 if the lexer did not intern it
     int boolVal;
-    int hasInt;
-    int hasBool;
     struct ASTNode** children;
     int childCount;
     int childCapacity;
     struct ASTNode* parent;
 } ASTNode;
 
-ASTNode* createNode(const char* type);
-ASTNode* createStrNode(const char* type, char* val);
-ASTNode* createIntNode(const char* type, int val);
-ASTNode* createBoolNode(const char* type, int val);
-void addChild(ASTNode* parent, ASTNode* child);
+ASTNode* createNode(Arena* arena, NodeKind kind);
+ASTNode* createStrNode(Arena* arena, NodeKind kind, Slice val);
+ASTNode* createBoolNode(Arena* arena, NodeKind kind, int val);
+void addChild(Arena* arena, ASTNode* parent, ASTNode* child);
 void printAST(ASTNode* node, int indent, int isLast);
+size_t countNodes(const ASTNode* node);
 
 #endif
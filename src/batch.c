@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "csv-writer.h"
+#include "input.h"
+#include "log.h"
+#include "parallel.h"
+#include "parse.h"
+#include "stream.h"
+#include "symbol_table.h"
+
+static int addPath(BatchInputs* in, const char* path) {
+    if (in->count == in->cap) {
+        int cap = in->cap ? in->cap * 2 : 64;
+        char** paths = realloc(in->paths, sizeof(char*) * cap);
+        if (!paths) return 0;
+        in->paths = paths;
+        in->cap = cap;
+    }
+    in->paths[in->count] = strdup(path);
+    if (!in->paths[in->count]) return 0;
+    in->count++;
+    return 1;
+}
+
+// Adds one input, or every file matching it if it holds a wildcard. Long
+// file lists can be passed quoted so they do not hit the argument limit.
+int batchAddInput(BatchInputs* in, const char* pattern) {
+    if (!strpbrk(pattern, "*?[")) {
+        if (addPath(in, pattern)) return 1;
+        logError("Memory allocation failed for input list");
+        return 0;
+    }
+
+    glob_t matches;
+    int rc = glob(pattern, 0, NULL, &matches);
+    if (rc == GLOB_NOMATCH) {
+        logError("No input files match '%s'", pattern);
+        return 0;
+    }
+    if (rc != 0) {
+        logError("Could not expand '%s'", pattern);
+        return 0;
+    }
+    int ok = 1;
+    for (size_t i = 0; i < matches.gl_pathc && ok; i++) {
+        ok = addPath(in, matches.gl_pathv[i]);
+    }
+    globfree(&matches);
+    if (!ok) logError("Memory allocation failed for input list");
+    return ok;
+}
+
+// Reads one input path per line; "-" reads the list from stdin. Blank
+// lines are skipped.
+int batchReadList(BatchInputs* in, const char* listPath) {
+    FILE* list = strcmp(listPath, "-") == 0 ? stdin : fopen(listPath, "r");
+    if (!list) {
+        logError("Could not open file list '%s': %s", listPath, strerror(errno));
+        return 0;
+    }
+
+    char* lineBuf = NULL;
+    size_t lineCap = 0;
+    ssize_t n;
+    int ok = 1;
+    while (ok && (n = getline(&lineBuf, &lineCap, list)) >= 0) {
+        while (n > 0 && (lineBuf[n - 1] == '\n' || lineBuf[n - 1] == '\r')) {
+            lineBuf[--n] = '\0';
+        }
+        if (n == 0) continue;
+        ok = addPath(in, lineBuf);
+        if (!ok) logError("Memory allocation failed for input list");
+    }
+    free(lineBuf);
+    if (list != stdin) fclose(list);
+    return ok;
+}
+
+void batchFreeInputs(BatchInputs* in) {
+    for (int i = 0; i < in->count; i++) {
+        free(in->paths[i]);
+    }
+    free(in->paths);
+    memset(in, 0, sizeof(*in));
+}
+
+typedef struct {
+    InputBuffer input;  // Kept open while rows point into it
+    SymbolTable symbols;
+    int converted;
+    int written;        // Every CSV file of the input was written
+    int tables;         // Tables written for this input
+    long rows;
+} BatchFile;
+
+typedef struct {
+    const BatchInputs* in;
+    const BatchOptions* opt;
+    BatchFile* files;
+    char** dirs;        // Output directory of each input, NULL if none are written
+} Batch;
+
+static void countRows(const SymbolTable* st, int* tables, long* rows) {
+    for (int i = 0; i < st->registry.count; i++) {
+        if (!st->registry.tables[i]->rowCount) continue;
+        (*tables)++;
+        *rows += st->registry.tables[i]->rowCount;
+    }
+}
+
+// Output directory of one input: its file name without the extension,
+// inside outDir.
+static char* inputOutDir(const char* outDir, const char* path) {
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    const char* dot = strrchr(name, '.');
+    size_t nameLen = dot && dot != name ? (size_t)(dot - name) : strlen(name);
+    char* dir = malloc(strlen(outDir) + nameLen + 2);
+    if (!dir) return NULL;
+    sprintf(dir, "%s/%.*s", outDir, (int)nameLen, name);
+    return dir;
+}
+
+static void freeOutDirs(char** dirs, int count) {
+    for (int i = 0; dirs && i < count; i++) {
+        free(dirs[i]);
+    }
+    free(dirs);
+}
+
+typedef struct {
+    const char* dir;
+    int index;
+} NamedDir;
+
+static int compareDirs(const void* a, const void* b) {
+    const NamedDir* x = a;
+    const NamedDir* y = b;
+    int c = strcmp(x->dir, y->dir);
+    return c ? c : x->index - y->index;
+}
+
+// Names the output directory of every input. Inputs that would share one
+// (a/x.json and b/x.json) are rejected before anything is converted, as
+// their threads would otherwise overwrite each other's CSV files.
+static char** inputOutDirs(const BatchInputs* in, const char* outDir) {
+    char** dirs = calloc(in->count ? in->count : 1, sizeof(char*));
+    NamedDir* sorted = malloc(sizeof(NamedDir) * (in->count ? in->count : 1));
+    int ok = dirs && sorted;
+    for (int i = 0; ok && i < in->count; i++) {
+        dirs[i] = inputOutDir(outDir, in->paths[i]);
+        sorted[i].dir = dirs[i];
+        sorted[i].index = i;
+        ok = dirs[i] != NULL;
+    }
+    if (!ok) {
+        logError("Memory allocation failed for output directories");
+        freeOutDirs(dirs, in->count);
+        free(sorted);
+        return NULL;
+    }
+
+    qsort(sorted, in->count, sizeof(NamedDir), compareDirs);
+    for (int k = 1; k < in->count; k++) {
+        if (strcmp(sorted[k - 1].dir, sorted[k].dir) != 0) continue;
+        logError("'%s' and '%s' would both be written to '%s'; rename one or use --merge",
+                 in->paths[sorted[k - 1].index], in->paths[sorted[k].index], sorted[k].dir);
+        ok = 0;
+    }
+    free(sorted);
+    if (!ok) {
+        freeOutDirs(dirs, in->count);
+        return NULL;
+    }
+    return dirs;
+}
+
+static int writeInput(const char* dir, const SymbolTable* st) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        logError("Could not create output directory '%s': %s", dir, strerror(errno));
+        return 0;
+    }
+    // Files are spread over the pool already, so each one writes its
+    // tables on its own thread
+    return saveSymbolTableToCSV(st, dir, 1, NULL);
+}
+
+static void convertFile(void* ctx, int index) {
+    Batch* b = ctx;
+    BatchFile* f = &b->files[index];
+    const char* path = b->in->paths[index];
+    initSymbolTable(&f->symbols);
+    if (!inputOpenFile(&f->input, path)) {
+        return;
+    }
+
+    if (b->opt->stream) {
+        f->converted = streamConvert(&f->symbols, f->input.data, f->input.len, 1);
+    } else {
+        ParseContext parse;
+        parseInit(&parse);
+        f->converted = parseDocument(&parse, f->input.data, f->input.len, &f->symbols.keys, 1) == 0 && parse.root;
+        if (f->converted) walkDocument(&f->symbols, parse.root, 1);
+        parseFree(&parse);
+    }
+    if (!f->converted) {
+        logError("Failed to convert '%s'", path);
+    }
+    if (b->opt->merge) return;
+
+    if (f->converted) {
+        countRows(&f->symbols, &f->tables, &f->rows);
+        f->written = !b->dirs || writeInput(b->dirs[index], &f->symbols);
+    }
+    freeSymbolTables(&f->symbols);
+    inputClose(&f->input);
+}
+
+// Converts every input on the thread pool. Each one gets its own tables
+// and output directory, or with merge all of them are combined in input
+// order as if they were one document after another, so ids do not depend
+// on which thread finished first. Returns 1 if every input was converted
+// and written.
+int batchConvert(const BatchInputs* in, const BatchOptions* opt) {
+    Batch b = { in, opt, NULL, NULL };
+    if (opt->outDir && !opt->merge) {
+        b.dirs = inputOutDirs(in, opt->outDir);
+        if (!b.dirs) return 0;
+    }
+    b.files = calloc(in->count ? in->count : 1, sizeof(BatchFile));
+    if (!b.files) {
+        logError("Memory allocation failed for batch state");
+        freeOutDirs(b.dirs, in->count);
+        return 0;
+    }
+
+    logInfo("Converting %d files", in->count);
+    parallelFor(in->count, parallelJobCount(), convertFile, &b);
+
+    int ok = 1;
+    int converted = 0;
+    int tables = 0;
+    long rows = 0;
+    SymbolTable merged;
+    initSymbolTable(&merged);
+    for (int i = 0; i < in->count; i++) {
+        BatchFile* f = &b.files[i];
+        if (!f->converted) {
+            ok = 0;
+        } else {
+            converted++;
+        }
+        if (!opt->merge) {
+            if (f->converted && !f->written) ok = 0;
+            tables += f->tables;
+            rows += f->rows;
+        } else if (f->converted) {
+            if (!mergeSymbolTable(&merged, &f->symbols)) ok = 0;
+        } else {
+            freeSymbolTables(&f->symbols);
+        }
+    }
+
+    if (opt->merge) {
+        countRows(&merged, &tables, &rows);
+        if (opt->printSymbols) {
+            printf("\n------------------------- Symbol Table -------------------------\n\n");
+            printSymbolTables(&merged);
+        }
+        if (opt->outDir && !saveSymbolTableToCSV(&merged, opt->outDir, parallelJobCount(), NULL)) {
+            ok = 0;
+        }
+        freeSymbolTables(&merged);
+        for (int i = 0; i < in->count; i++) {
+            inputClose(&b.files[i].input);
+        }
+    }
+
+    printf("Batch summary: %d of %d files converted, %d failed, %ld rows in %d tables\n",
+           converted, in->count, in->count - converted, rows, tables);
+    free(b.files);
+    freeOutDirs(b.dirs, in->count);
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Batch mode: many input files converted by one process on a pool of
+// --jobs threads.
+
+typedef struct {
+    char** paths;       // Input files in the order given
+    int count;
+    int cap;
+} BatchInputs;
+
+typedef struct {
+    const char* outDir; // Where CSV files go, NULL to write none
+    int merge;          // One set of tables for all inputs, else a directory per input
+    int stream;         // Convert without building ASTs (--stream)
+    int printSymbols;   // Print the merged symbol table
+} BatchOptions;
+
+int batchAddInput(BatchInputs* in, const char* pattern);
+int batchReadList(BatchInputs* in, const char* listPath);
+void batchFreeInputs(BatchInputs* in);
+int batchConvert(const BatchInputs* in, const BatchOptions* opt);
+
+#endif
@@ -1,29 +1,154 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <libgen.h> // For basename
+#include <pthread.h>
+#include <unistd.h>
 #include "csv-writer.h"
+#include "log.h"
+#include "output.h"
+#include "parallel.h"
 #include "symbol_table.h"
 
-// Helper function to escape CSV strings (handles quotes and commas)
-static char* escape_csv_string(const char* input) {
-    if (!input) return strdup("");
-    size_t len = strlen(input);
-    size_t new_len = len + 1; // Null terminator
-    for (size_t i = 0; i < len; i++) {
-        if (input[i] == '"' || input[i] == ',') new_len++;
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_X86 1
+#endif
+
+size_t csvBufferSize = OUTPUT_DEFAULT_BUFFER_SIZE;
+int csvAlwaysQuote = 0;
+int csvPrintSaved = 1;
+
+// Helper function to write a quoted CSV field, doubling embedded quotes
+// in place in the output buffer
+static void write_quoted_field(OutputBuffer* out, Slice field) {
+    // Worst case every byte is a quote
+    char* dst = outputReserve(out, (size_t)field.len * 2 + 2);
+    if (!dst) {
+        // Larger than the buffer: write it piecewise
+        const char* p = field.ptr;
+        const char* end = field.ptr + field.len;
+        outputByte(out, '"');
+        while (p < end) {
+            const char* quote = memchr(p, '"', (size_t)(end - p));
+            if (!quote) {
+                outputBytes(out, p, (size_t)(end - p));
+                break;
+            }
+            outputBytes(out, p, (size_t)(quote - p) + 1);
+            outputByte(out, '"');
+            p = quote + 1;
+        }
+        outputByte(out, '"');
+        return;
+    }
+
+    char* start = dst;
+    const char* p = field.ptr;
+    const char* end = field.ptr + field.len;
+    *dst++ = '"';
+    while (p < end) {
+        const char* quote = memchr(p, '"', (size_t)(end - p));
+        size_t n = quote ? (size_t)(quote - p) + 1 : (size_t)(end - p);
+        memcpy(dst, p, n);
+        dst += n;
+        if (!quote) break;
+        *dst++ = '"';
+        p = quote + 1;
     }
-    char* result = malloc(new_len);
-    if (!result) return strdup("");
-    size_t j = 0;
-    result[j++] = '"';
-    for (size_t i = 0; i < len; i++) {
-        if (input[i] == '"') result[j++] = '"';
-        result[j++] = input[i];
+    *dst++ = '"';
+    out->len += (size_t)(dst - start);
+}
+
+// Per RFC 4180 a field needs quotes only if it holds a quote, comma, CR
+// or LF. The scanners return the offset of the first such byte, or n.
+typedef size_t (*SpecialScanFn)(const char* p, size_t n);
+
+static int isSpecial(char c) {
+    return c == '"' || c == ',' || c == '\r' || c == '\n';
+}
+
+static size_t scanSpecialScalar(const char* p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (isSpecial(p[i])) return i;
     }
-    result[j++] = '"';
-    result[j] = '\0';
-    return result;
+    return n;
+}
+
+#ifdef CSV_X86
+__attribute__((target("sse2")))
+static size_t scanSpecialSse(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + scanSpecialScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scanSpecialAvx2(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + scanSpecialSse(p + i, n - i);
+}
+#endif
+
+static SpecialScanFn pickSpecialScan(void) {
+#ifdef CSV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scanSpecialAvx2;
+    return scanSpecialSse;
+#endif
+    return scanSpecialScalar;
+}
+
+static SpecialScanFn scanSpecial;
+static pthread_once_t scanSpecialOnce = PTHREAD_ONCE_INIT;
+
+static void initSpecialScan(void) {
+    scanSpecial = pickSpecialScan();
+}
+
+// Writes a field bare when it can be, quoted otherwise. Empty strings keep
+// their quotes so they stay distinct from nulls.
+static void write_csv_field(OutputBuffer* out, Slice field) {
+    if (csvAlwaysQuote || field.len == 0 || scanSpecial(field.ptr, field.len) < field.len) {
+        write_quoted_field(out, field);
+    } else {
+        outputBytes(out, field.ptr, field.len);
+    }
+}
+
+static void write_csv_value(OutputBuffer* out, const Value* value) {
+    if (value->type == VALUE_NULL) return; // Nulls are left unquoted and empty
+    if (value->type == VALUE_INT) {
+        if (csvAlwaysQuote) outputByte(out, '"');
+        outputInt(out, value->as.i);
+        if (csvAlwaysQuote) outputByte(out, '"');
+        return;
+    }
+    if (value->type == VALUE_NUMBER) {
+        // The digits of the input, which never need quoting
+        if (csvAlwaysQuote) outputByte(out, '"');
+        outputBytes(out, value->as.s.ptr, value->as.s.len);
+        if (csvAlwaysQuote) outputByte(out, '"');
+        return;
+    }
+    char buffer[32];
+    write_csv_field(out, valueText(value, buffer, sizeof(buffer)));
 }
 
 // Helper function to construct file path
@@ -45,68 +170,380 @@ static char* construct_file_path(const char* out_dir, const char* table_name) {
     return filename;
 }
 
-void saveSymbolTableToCSV(const char* out_dir) {
-    if (!out_dir) out_dir = "."; // Default to current directory
+// Writes the rows a table holds; row j is slot j of every column. Write
+// errors are reported once, when the buffer is flushed.
+static void write_rows(OutputBuffer* out, const Table* table, int has_parent) {
+    for (int j = 0; j < table->rowCount && !out->failed; j++) {
+        outputInt(out, table->ids[j]);
+        if (has_parent) {
+            outputByte(out, ',');
+            outputInt(out, table->parentIds[j]);
+        }
+        for (int k = 0; k < table->columnCount; k++) {
+            outputByte(out, ',');
+            Value value = columnValue(&table->columns[k], j);
+            write_csv_value(out, &value);
+        }
+        outputByte(out, '\n');
+    }
+}
 
-    // Iterate through all tables
-    for (int i = 0; i < tableCount; i++) {
-        Table* table = tables[i];
-        if (!table->rowCount || !table->rows) continue; // Skip empty tables
+static int has_parent_ids(const Table* table) {
+    for (int j = 0; j < table->rowCount; j++) {
+        if (table->parentIds[j] != 0) return 1;
+    }
+    return 0;
+}
 
-        // Construct file path
-        char* filepath = construct_file_path(out_dir, table->name);
-        if (!filepath) {
-            fprintf(stderr, "Error: Memory allocation failed for file path.\n");
-            continue;
-        }
+// Rows written out while the document is still being converted
+// (--stream). Each table's rows are formatted into its own buffer, which
+// is appended to one temporary file whenever it fills; the chunks are
+// copied into the table's CSV file after the header, which can only be
+// written once every row is known.
 
-        // Open file
-        FILE* fp = fopen(filepath, "w");
-        if (!fp) {
-            fprintf(stderr, "Error: Could not open file %s for writing.\n", filepath);
-            free(filepath);
-            continue;
+#define CSV_SPILL_BUFFER_SIZE (64 << 10)
+
+typedef struct {
+    off_t offset;
+    size_t len;
+} SpillChunk;
+
+struct CsvSpillRows {
+    OutputBuffer out;   // Rows not in the file yet; out.fd is the spill file
+    size_t flushed;     // out.written when the last chunk was noted
+    SpillChunk* chunks; // Where the rest are, in row order
+    int chunkCount;
+    int chunkCap;
+    int hasParent;      // Some spilled row has a parent id
+    struct CsvSpillRows* next;
+};
+
+struct CsvSpill {
+    int fd;             // Unlinked temporary file, -1 to drop rows instead
+    char* path;         // For error messages
+    off_t size;         // Bytes written to it
+    CsvSpillRows* tables;
+};
+
+// The file is created in out_dir, as the CSV files will take about as
+// much room there, and removed straight away so that nothing is left
+// behind if the program dies. Without out_dir rows are only counted.
+CsvSpill* csvSpillOpen(const char* out_dir) {
+    pthread_once(&scanSpecialOnce, initSpecialScan);
+    CsvSpill* spill = calloc(1, sizeof(CsvSpill));
+    if (!spill) {
+        logError("Memory allocation failed for spill file");
+        return NULL;
+    }
+    spill->fd = -1;
+    if (!out_dir) return spill;
+
+    spill->path = malloc(strlen(out_dir) + 32);
+    if (!spill->path) {
+        logError("Memory allocation failed for spill file");
+        free(spill);
+        return NULL;
+    }
+    sprintf(spill->path, "%s/.json2relcsv-XXXXXX", out_dir);
+    spill->fd = mkstemp(spill->path);
+    if (spill->fd < 0) {
+        logError("Could not create temporary file in %s: %s", out_dir, strerror(errno));
+        free(spill->path);
+        free(spill);
+        return NULL;
+    }
+    unlink(spill->path);
+    return spill;
+}
+
+static CsvSpillRows* spill_rows_for(CsvSpill* spill, Table* table) {
+    if (table->spill) return table->spill;
+    CsvSpillRows* rows = calloc(1, sizeof(CsvSpillRows));
+    if (rows) rows->out.buf = malloc(CSV_SPILL_BUFFER_SIZE);
+    if (!rows || !rows->out.buf) {
+        logError("Memory allocation failed for rows of table %s", table->name);
+        free(rows);
+        return NULL;
+    }
+    rows->out.fd = spill->fd;
+    rows->out.cap = CSV_SPILL_BUFFER_SIZE;
+    rows->out.path = spill->path;
+    rows->next = spill->tables;
+    spill->tables = rows;
+    table->spill = rows;
+    return rows;
+}
+
+// A RowSink: appends the rows table holds to the spill and drops them.
+// Only this table's buffer is flushed meanwhile, so whatever reached the
+// file is one chunk at its end.
+int csvSpillRows(void* ctx, const SymbolTable* st, Table* table) {
+    CsvSpill* spill = ctx;
+    (void)st;
+    if (spill->fd >= 0) {
+        CsvSpillRows* rows = spill_rows_for(spill, table);
+        if (!rows) return 0;
+        rows->hasParent |= has_parent_ids(table);
+        write_rows(&rows->out, table, 1);
+        if (rows->out.failed) return 0;
+        size_t n = rows->out.written - rows->flushed;
+        if (n) {
+            SpillChunk* last = rows->chunkCount ? &rows->chunks[rows->chunkCount - 1] : NULL;
+            if (last && last->offset + (off_t)last->len == spill->size) {
+                last->len += n;
+            } else {
+                if (rows->chunkCount == rows->chunkCap) {
+                    int cap = rows->chunkCap ? rows->chunkCap * 2 : 16;
+                    SpillChunk* chunks = realloc(rows->chunks, sizeof(SpillChunk) * cap);
+                    if (!chunks) {
+                        logError("Memory allocation failed for rows of table %s", table->name);
+                        return 0;
+                    }
+                    rows->chunks = chunks;
+                    rows->chunkCap = cap;
+                }
+                rows->chunks[rows->chunkCount].offset = spill->size;
+                rows->chunks[rows->chunkCount].len = n;
+                rows->chunkCount++;
+            }
+            spill->size += (off_t)n;
+            rows->flushed = rows->out.written;
         }
+    }
+    table->rowsSpilled += table->rowCount;
+    clearTableRows(table);
+    return 1;
+}
+
+// Call only once the tables have been written; they keep pointing here.
+void csvSpillFree(CsvSpill* spill) {
+    if (!spill) return;
+    while (spill->tables) {
+        CsvSpillRows* next = spill->tables->next;
+        free(spill->tables->out.buf);
+        free(spill->tables->chunks);
+        free(spill->tables);
+        spill->tables = next;
+    }
+    if (spill->fd >= 0) close(spill->fd);
+    free(spill->path);
+    free(spill);
+}
+
+// Where copy_rows() is in the spilled rows, which can end mid-row.
+typedef enum {
+    ROW_ID,
+    ROW_PARENT,
+    ROW_REST,
+    ROW_REST_QUOTED
+} RowPart;
 
-        // Collect unique keys and determine if parent_id is needed
-        int has_parent = 0;
-        for (int j = 0; j < table->rowCount; j++) {
-            if (table->rows[j]->parentId != 0) {
-                has_parent = 1;
+// Copies spilled rows, which always carry the parent id column, leaving
+// that column out if the table turned out not to need it. Ids are never
+// quoted, so only the quotes after them matter in finding where rows end.
+static void copy_rows(OutputBuffer* out, const char* p, size_t n, int has_parent, RowPart* part) {
+    if (has_parent) {
+        outputBytes(out, p, n);
+        return;
+    }
+    const char* end = p + n;
+    const char* run = p;
+    for (; p < end; p++) {
+        switch (*part) {
+            case ROW_ID:
+                if (*p == ',') {
+                    outputBytes(out, run, (size_t)(p - run));
+                    *part = ROW_PARENT;
+                }
+                break;
+            case ROW_PARENT:
+                if (*p == ',' || *p == '\n') {
+                    run = p;
+                    *part = *p == ',' ? ROW_REST : ROW_ID;
+                }
                 break;
+            case ROW_REST:
+                if (*p == '"') *part = ROW_REST_QUOTED;
+                else if (*p == '\n') *part = ROW_ID;
+                break;
+            case ROW_REST_QUOTED:
+                if (*p == '"') *part = ROW_REST;
+                break;
+        }
+    }
+    if (*part != ROW_PARENT) outputBytes(out, run, (size_t)(end - run));
+}
+
+static int copy_spilled_rows(OutputBuffer* out, const CsvSpillRows* rows, int has_parent) {
+    RowPart part = ROW_ID;
+    size_t cap = CSV_SPILL_BUFFER_SIZE;
+    char* buf = malloc(cap);
+    if (!buf) {
+        logError("Memory allocation failed for copying rows");
+        return 0;
+    }
+    for (int i = 0; i < rows->chunkCount && !out->failed; i++) {
+        off_t offset = rows->chunks[i].offset;
+        size_t left = rows->chunks[i].len;
+        while (left > 0) {
+            ssize_t n = pread(rows->out.fd, buf, left < cap ? left : cap, offset);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                logError("Failed to read %s: %s", rows->out.path, n < 0 ? strerror(errno) : "file is short");
+                free(buf);
+                return 0;
             }
+            copy_rows(out, buf, (size_t)n, has_parent, &part);
+            offset += n;
+            left -= (size_t)n;
         }
+    }
+    free(buf);
+    copy_rows(out, rows->out.buf, rows->out.len, has_parent, &part);
+    return 1;
+}
+
+// Writes one table. Returns 0 if the file could not be written in full.
+static int write_table_csv(const SymbolTable* st, const Table* table, const char* filepath, size_t* bytes) {
+    OutputBuffer out;
+    if (!outputOpen(&out, filepath, csvBufferSize)) {
+        return 0;
+    }
+
+    // Determine if parent_id is needed
+    const CsvSpillRows* spilled = table->spill;
+    int has_parent = (spilled && spilled->hasParent) || has_parent_ids(table);
+
+    // Write header
+    outputStr(&out, "id");
+    if (has_parent) {
+        outputByte(&out, ',');
+        outputStr(&out, table->parentName ? table->parentName : "parent");
+        outputStr(&out, "_id");
+    }
+    for (int k = 0; k < table->columnCount; k++) {
+        outputByte(&out, ',');
+        write_csv_field(&out, internedSlice(&st->keys, table->columns[k].keyId));
+    }
+    outputByte(&out, '\n');
+
+    // Rows written out early come first
+    int ok = !spilled || copy_spilled_rows(&out, spilled, has_parent);
+    write_rows(&out, table, has_parent);
 
-        // Write header
-        fprintf(fp, "id");
-        if (has_parent) fprintf(fp, ",%s_id", table->parentName ? table->parentName : "parent");
-        for (int k = 0; k < table->rows[0]->keyCount; k++) {
-            char* escaped_key = escape_csv_string(table->rows[0]->keys[k]);
-            fprintf(fp, ",%s", escaped_key);
-            free(escaped_key);
+    ok = outputClose(&out) && ok;
+    *bytes = out.written;
+    return ok;
+}
+
+typedef struct {
+    const Table* table;
+    int index;          // Position in the registry
+    long cells;         // Size estimate used for scheduling
+} TableRef;
+
+typedef struct {
+    const SymbolTable* st;
+    TableRef* order;    // Tables to write, largest first
+    char** paths;       // File path per registry index
+    int* written;       // Result per registry index
+    size_t* bytes;      // Bytes written per registry index
+} SaveJob;
+
+static void save_table_job(void* ctx, int k) {
+    SaveJob* job = ctx;
+    int i = job->order[k].index;
+    job->written[i] = write_table_csv(job->st, job->order[k].table, job->paths[i], &job->bytes[i]);
+}
+
+static int compare_by_name(const void* a, const void* b) {
+    const TableRef* x = a;
+    const TableRef* y = b;
+    int c = strcmp(x->table->name, y->table->name);
+    return c ? c : (x->index > y->index) - (x->index < y->index);
+}
+
+static int compare_by_size(const void* a, const void* b) {
+    const TableRef* x = a;
+    const TableRef* y = b;
+    if (x->cells != y->cells) return (x->cells < y->cells) - (x->cells > y->cells);
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Tables are written on up to jobs threads, each to its own file. When
+// several tables share a name only the last one is written, which is the
+// file a one-by-one write would have left behind. If bytesWritten is not
+// NULL it receives the file size of each table by registry index, 0 for
+// tables that were not written.
+int saveSymbolTableToCSV(const SymbolTable* st, const char* out_dir, int jobs, size_t* bytesWritten) {
+    if (!out_dir) out_dir = "."; // Default to current directory
+    pthread_once(&scanSpecialOnce, initSpecialScan);
+    const TableRegistry* reg = &st->registry;
+    if (reg->count == 0) return 1;
+
+    SaveJob job;
+    TableRef* byName = malloc(sizeof(TableRef) * reg->count);
+    job.st = st;
+    job.order = malloc(sizeof(TableRef) * reg->count);
+    job.paths = calloc(reg->count, sizeof(char*));
+    job.written = calloc(reg->count, sizeof(int));
+    job.bytes = calloc(reg->count, sizeof(size_t));
+    if (!byName || !job.order || !job.paths || !job.written || !job.bytes) {
+        logError("Memory allocation failed for CSV output");
+        free(byName);
+        free(job.order);
+        free(job.paths);
+        free(job.written);
+        free(job.bytes);
+        return 0;
+    }
+
+    for (int i = 0; i < reg->count; i++) {
+        const Table* table = reg->tables[i];
+        byName[i].table = table;
+        byName[i].index = i;
+        byName[i].cells = ((long)table->rowsSpilled + table->rowCount) * (table->columnCount + 2);
+    }
+    qsort(byName, reg->count, sizeof(TableRef), compare_by_name);
+
+    int ok = 1;
+    int count = 0;
+    for (int k = 0; k < reg->count; k++) {
+        const Table* table = byName[k].table;
+        int i = byName[k].index;
+        if (!table->rowCount && !table->rowsSpilled) continue; // Skip empty tables
+        if (k + 1 < reg->count && strcmp(byName[k + 1].table->name, table->name) == 0) {
+            continue; // Overwritten by a later table of the same name
         }
-        fprintf(fp, "\n");
-
-        // Write rows
-        for (int j = 0; j < table->rowCount; j++) {
-            Row* row = table->rows[j];
-            fprintf(fp, "%d", row->id);
-            if (has_parent) fprintf(fp, ",%d", row->parentId);
-            for (int k = 0; k < row->keyCount; k++) {
-                char* escaped_value = escape_csv_string(row->values[k]);
-                fprintf(fp, ",%s", escaped_value);
-                free(escaped_value);
-            }
-            fprintf(fp, "\n");
-            // Flush to handle large files
-            if (fflush(fp) != 0) {
-                fprintf(stderr, "Error: Failed to write to %s.\n", filepath);
-                break;
-            }
+
+        // Construct file path
+        job.paths[i] = construct_file_path(out_dir, table->name);
+        if (!job.paths[i]) {
+            logError("Memory allocation failed for file path");
+            ok = 0;
+            continue;
         }
+        job.order[count++] = byName[k];
+    }
+    qsort(job.order, count, sizeof(TableRef), compare_by_size);
 
-        fclose(fp);
-        printf("Table %s saved to %s\n", table->name, filepath);
-        free(filepath);
+    parallelFor(count, jobs, save_table_job, &job);
+
+    // Report in table order regardless of which thread finished first
+    for (int i = 0; i < reg->count; i++) {
+        if (!job.paths[i]) continue;
+        if (job.written[i]) {
+            if (csvPrintSaved) printf("Table %s saved to %s\n", reg->tables[i]->name, job.paths[i]);
+        } else {
+            ok = 0;
+        }
+        free(job.paths[i]);
     }
-}
\ No newline at end of file
+    if (bytesWritten) memcpy(bytesWritten, job.bytes, sizeof(size_t) * reg->count);
+    free(byName);
+    free(job.order);
+    free(job.paths);
+    free(job.written);
+    free(job.bytes);
+    return ok;
+}
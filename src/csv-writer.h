@@ -1,6 +1,23 @@
 #ifndef CSV_WRITER_H
 #define CSV_WRITER_H
 
-void saveSymbolTableToCSV(const char* filename);
+#include <stddef.h>
+#include "symbol_table.h"
 
-#endif
\ No newline at end of file
+extern size_t csvBufferSize;    // Output buffer per CSV file, in bytes
+extern int csvAlwaysQuote;      // Quote every field, as older versions did
+extern int csvPrintSaved;       // Print a line to stdout for every file written
+
+int saveSymbolTableToCSV(const SymbolTable* st, const char* out_dir, int jobs, size_t* bytesWritten);
+
+// Holds the rows of a conversion in a temporary file as they complete, so
+// that they need not stay in memory until saveSymbolTableToCSV(), which
+// writes them out after each table's header.
+typedef struct CsvSpill CsvSpill;
+typedef struct CsvSpillRows CsvSpillRows;
+
+CsvSpill* csvSpillOpen(const char* out_dir);
+int csvSpillRows(void* spill, const SymbolTable* st, Table* table);
+void csvSpillFree(CsvSpill* spill);
+
+#endif
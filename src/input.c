@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+#include "log.h"
+
+#define READ_INITIAL_SIZE (64 << 10) // First read size for pipes and stdin; doubles as they fill
+
+// Maps a regular file read-only so the lexer works directly on the page
+// cache. Anything that cannot be mapped (pipes, /dev/stdin, ...) falls
+// back to inputReadStream().
+int inputOpenFile(InputBuffer* in, const char* path) {
+    memset(in, 0, sizeof(*in));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        logError("Could not open input file '%s': %s", path, strerror(errno));
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        int ok = inputReadStream(in, fd);
+        close(fd);
+        return ok;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        int ok = inputReadStream(in, fd);
+        close(fd);
+        return ok;
+    }
+    close(fd);
+
+    // Both hints are advisory; kernels without THP for file mappings
+    // simply reject the second one.
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(map, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+
+    in->data = map;
+    in->len = (size_t)st.st_size;
+    in->mapped = 1;
+    return 1;
+}
+
+// Reads a non-seekable stream into one buffer that doubles whenever it is
+// full, so small documents (server and library requests) stay small and
+// large ones still get large reads.
+int inputReadStream(InputBuffer* in, int fd) {
+    memset(in, 0, sizeof(*in));
+    size_t cap = READ_INITIAL_SIZE;
+    size_t len = 0;
+    char* buf = malloc(cap);
+    if (!buf) {
+        logError("Memory allocation failed for input buffer");
+        return 0;
+    }
+
+    for (;;) {
+        if (len == cap) {
+            cap *= 2;
+            char* newBuf = realloc(buf, cap);
+            if (!newBuf) {
+                logError("Memory allocation failed for input buffer");
+                free(buf);
+                return 0;
+            }
+            buf = newBuf;
+        }
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            logError("Failed to read input: %s", strerror(errno));
+            free(buf);
+            return 0;
+        }
+        len += (size_t)n;
+    }
+
+    in->data = buf;
+    in->len = len;
+    in->mapped = 0;
+    return 1;
+}
+
+void inputClose(InputBuffer* in) {
+    if (in->mapped) {
+        munmap((void*)in->data, in->len);
+    } else {
+        free((void*)in->data);
+    }
+    in->data = NULL;
+    in->len = 0;
+    in->mapped = 0;
+}
@@ -0,0 +1,16 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+
+typedef struct {
+    const char* data;   // Whole input document
+    size_t len;         // Length in bytes
+    int mapped;         // 1 if data is a read-only mapping of the file
+} InputBuffer;
+
+int inputOpenFile(InputBuffer* in, const char* path);
+int inputReadStream(InputBuffer* in, int fd);
+void inputClose(InputBuffer* in);
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "log.h"
+
+#define INTERN_INITIAL_SLOTS 256
+
+// Word-at-a-time hash; keys are short, so this beats a byte loop and is
+// good enough for an open-addressing table with linear probing.
+uint64_t hashBytes(const char* p, size_t len) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = mix64(h ^ w);
+        p += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, len);
+    return mix64(h ^ tail);
+}
+
+static int grow(Interner* in) {
+    uint32_t slotCount = in->slots ? (in->slotMask + 1) * 2 : INTERN_INITIAL_SLOTS;
+    int* slots = calloc(slotCount, sizeof(int));
+    if (!slots) return 0;
+    for (int id = 0; id < in->count; id++) {
+        uint32_t i = (uint32_t)in->hashes[id] & (slotCount - 1);
+        while (slots[i]) i = (i + 1) & (slotCount - 1);
+        slots[i] = id + 1;
+    }
+    free(in->slots);
+    in->slots = slots;
+    in->slotMask = slotCount - 1;
+    return 1;
+}
+
+// Returns the id of s, adding it if it was not seen before. The slice is
+// stored as is, so it must outlive the interner (input buffer or literal),
+// unless it is SLICE_TRANSIENT: those keys are copied when first seen.
+int internSlice(Interner* in, Slice s) {
+    if (!in->slots || (uint32_t)(in->count + 1) * 2 > in->slotMask + 1) {
+        if (!grow(in)) {
+            logError("Memory allocation failed for key table");
+            return -1;
+        }
+    }
+
+    uint64_t h = hashBytes(s.ptr, s.len);
+    uint32_t i = (uint32_t)h & in->slotMask;
+    while (in->slots[i]) {
+        int id = in->slots[i] - 1;
+        if (in->hashes[id] == h && sliceEq(in->keys[id], s)) {
+            return id;
+        }
+        i = (i + 1) & in->slotMask;
+    }
+
+    if (in->count == in->cap) {
+        int cap = in->cap ? in->cap * 2 : 64;
+        Slice* keys = realloc(in->keys, sizeof(Slice) * cap);
+        if (!keys) return -1;
+        in->keys = keys;
+        uint64_t* hashes = realloc(in->hashes, sizeof(uint64_t) * cap);
+        if (!hashes) return -1;
+        in->hashes = hashes;
+        in->cap = cap;
+    }
+
+    if (s.flags & SLICE_TRANSIENT) {
+        char* copy = sliceDup(s);
+        if (!copy) return -1;
+        s.ptr = copy;
+        s.flags = SLICE_OWNED;
+    } else {
+        s.flags = 0;
+    }
+    int id = in->count++;
+    in->keys[id] = s;
+    in->hashes[id] = h;
+    in->slots[i] = id + 1;
+    return id;
+}
+
+Slice internedSlice(const Interner* in, int id) {
+    return in->keys[id];
+}
+
+// Copies the keys from id from on out of the buffer they point into, so
+// that the buffer can be released while the interner is still in use.
+int internCopyKeys(Interner* in, int from) {
+    for (int id = from; id < in->count; id++) {
+        if (in->keys[id].flags & SLICE_OWNED) continue;
+        char* copy = sliceDup(in->keys[id]);
+        if (!copy) return 0;
+        in->keys[id].ptr = copy;
+        in->keys[id].flags = SLICE_OWNED;
+    }
+    return 1;
+}
+
+// Makes the empty interner in give the same ids as from. Its keys are
+// borrowed from from, which must outlive it.
+int internClone(Interner* in, const Interner* from) {
+    if (from->count == 0) return 1;
+    in->keys = malloc(sizeof(Slice) * from->cap);
+    in->hashes = malloc(sizeof(uint64_t) * from->cap);
+    in->slots = malloc(sizeof(int) * (from->slotMask + 1));
+    if (!in->keys || !in->hashes || !in->slots) {
+        freeInterner(in);
+        return 0;
+    }
+    for (int id = 0; id < from->count; id++) {
+        in->keys[id] = from->keys[id];
+        in->keys[id].flags = 0;
+    }
+    memcpy(in->hashes, from->hashes, sizeof(uint64_t) * from->count);
+    memcpy(in->slots, from->slots, sizeof(int) * (from->slotMask + 1));
+    in->count = from->count;
+    in->cap = from->cap;
+    in->slotMask = from->slotMask;
+    return 1;
+}
+
+void freeInterner(Interner* in) {
+    for (int id = 0; id < in->count; id++) {
+        sliceFree(&in->keys[id]);
+    }
+    free(in->keys);
+    free(in->hashes);
+    free(in->slots);
+    memset(in, 0, sizeof(*in));
+}
@@ -0,0 +1,33 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include "slice.h"
+
+typedef struct {
+    Slice* keys;        // Distinct strings, indexed by id
+    uint64_t* hashes;   // Hash of each key, indexed by id
+    int count;          // Number of distinct keys
+    int cap;            // Capacity of keys/hashes
+    int* slots;         // Open-addressing table of id + 1 (0 = empty)
+    uint32_t slotMask;  // Number of slots - 1 (power of two)
+} Interner;
+
+// 64-bit finalizer from MurmurHash3.
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t hashBytes(const char* p, size_t len);
+int internSlice(Interner* in, Slice s);
+Slice internedSlice(const Interner* in, int id);
+int internCopyKeys(Interner* in, int from);
+int internClone(Interner* in, const Interner* from);
+void freeInterner(Interner* in);
+
+#endif
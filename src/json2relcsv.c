@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json2relcsv.h"
+#include "log.h"
+#include "ndjson.h"
+#include "number.h"
+#include "parallel.h"
+#include "parse.h"
+#include "stream.h"
+#include "symbol_table.h"
+
+// What the sink has been told about one table.
+typedef struct {
+    const Table* table;
+    char** columns;     // NUL-terminated column names
+    int columnCount;    // Columns announced so far
+} TableState;
+
+struct J2RConverter {
+    J2ROptions options;
+    J2RSink sink;
+    SymbolTable symbols;    // Tables persist across feeds; rows do not
+    char* pending;          // Input not converted yet
+    size_t pendingLen;
+    size_t pendingCap;
+    int nextLine;           // Line number of the first pending line (NDJSON)
+    int keysCopied;         // Keys already moved out of the input
+    TableState* tables;     // In the order the sink first saw them
+    int tableCount;
+    int tableCap;
+    J2RValue* values;       // Row buffer handed to the sink
+    int valueCap;
+    int failed;
+};
+
+J2RConverter* j2rCreate(const J2ROptions* options, const J2RSink* sink) {
+    J2RConverter* c = calloc(1, sizeof(J2RConverter));
+    if (!c) return NULL;
+    if (options) c->options = *options;
+    if (sink) c->sink = *sink;
+    initSymbolTable(&c->symbols);
+    c->nextLine = 1;
+    return c;
+}
+
+// Rows are delivered in registry order, which is table creation order and
+// only grows at the end, so the table at registry index i is normally the
+// i-th one the sink saw.
+static TableState* tableState(J2RConverter* c, const Table* t, int hint) {
+    if (hint < c->tableCount && c->tables[hint].table == t) {
+        return &c->tables[hint];
+    }
+    for (int i = 0; i < c->tableCount; i++) {
+        if (c->tables[i].table == t) return &c->tables[i];
+    }
+    if (c->tableCount == c->tableCap) {
+        int cap = c->tableCap ? c->tableCap * 2 : 16;
+        TableState* tables = realloc(c->tables, sizeof(TableState) * cap);
+        if (!tables) return NULL;
+        c->tables = tables;
+        c->tableCap = cap;
+    }
+    TableState* ts = &c->tables[c->tableCount++];
+    memset(ts, 0, sizeof(TableState));
+    ts->table = t;
+    return ts;
+}
+
+// Names the columns the sink has not seen yet.
+static int addColumnNames(J2RConverter* c, TableState* ts) {
+    const Table* t = ts->table;
+    char** columns = realloc(ts->columns, sizeof(char*) * t->columnCount);
+    if (!columns) return 0;
+    ts->columns = columns;
+    for (; ts->columnCount < t->columnCount; ts->columnCount++) {
+        columns[ts->columnCount] = sliceDup(internedSlice(&c->symbols.keys, t->columns[ts->columnCount].keyId));
+        if (!columns[ts->columnCount]) return 0;
+    }
+    return 1;
+}
+
+static J2RValue publicValue(Value v) {
+    J2RValue out;
+    switch (v.type) {
+        case VALUE_INT:
+            out.type = J2R_INT;
+            out.as.i = v.as.i;
+            break;
+        case VALUE_DOUBLE:
+            out.type = J2R_DOUBLE;
+            out.as.d = v.as.d;
+            break;
+        case VALUE_BOOL:
+            out.type = J2R_BOOL;
+            out.as.b = v.as.b;
+            break;
+        case VALUE_STRING:
+            out.type = J2R_STRING;
+            out.as.s.ptr = v.as.s.ptr;
+            out.as.s.len = v.as.s.len;
+            break;
+        case VALUE_NUMBER: {
+            Number num = numberParse(v.as.s.ptr, v.as.s.len);
+            if (num.kind == NUMBER_INT) {
+                out.type = J2R_INT;
+                out.as.i = num.as.i;
+            } else if (num.kind == NUMBER_UINT) {
+                out.type = J2R_UINT;
+                out.as.u = num.as.u;
+            } else {
+                out.type = J2R_DOUBLE;
+                out.as.d = num.as.d;
+            }
+            break;
+        }
+        default:
+            out.type = J2R_NULL;
+            break;
+    }
+    return out;
+}
+
+// Hands every row converted so far to the sink and drops them, keeping the
+// tables so that later rows with the same schema land in the same table.
+static int deliverRows(J2RConverter* c) {
+    SymbolTable* st = &c->symbols;
+    int ok = 1;
+    for (int i = 0; ok && i < st->registry.count; i++) {
+        const Table* t = st->registry.tables[i];
+        if (!t->rowCount) continue;
+        TableState* ts = tableState(c, t, i);
+        if (!ts) {
+            logError("Memory allocation failed for table state");
+            ok = 0;
+            break;
+        }
+
+        J2RTable info;
+        info.index = (int)(ts - c->tables);
+        info.name = t->name;
+        info.parentName = t->parentName;
+        if (ts->columnCount < t->columnCount) {
+            if (!addColumnNames(c, ts)) {
+                logError("Memory allocation failed for column names");
+                ok = 0;
+                break;
+            }
+            info.columns = (const char* const*)ts->columns;
+            info.columnCount = ts->columnCount;
+            if (c->sink.table && !c->sink.table(c->sink.ctx, &info)) {
+                ok = 0;
+                break;
+            }
+        }
+        info.columns = (const char* const*)ts->columns;
+        info.columnCount = ts->columnCount;
+
+        if (t->columnCount > c->valueCap) {
+            J2RValue* values = realloc(c->values, sizeof(J2RValue) * t->columnCount);
+            if (!values) {
+                logError("Memory allocation failed for row values");
+                ok = 0;
+                break;
+            }
+            c->values = values;
+            c->valueCap = t->columnCount;
+        }
+        for (int j = 0; ok && j < t->rowCount; j++) {
+            for (int k = 0; k < t->columnCount; k++) {
+                c->values[k] = publicValue(columnValue(&t->columns[k], j));
+            }
+            J2RRow row = { t->ids[j], t->parentIds[j], c->values };
+            if (c->sink.row && !c->sink.row(c->sink.ctx, &info, &row)) ok = 0;
+        }
+    }
+    clearRows(st);
+
+    // Keys first seen in these rows still point into the input
+    if (!internCopyKeys(&st->keys, c->keysCopied)) {
+        logError("Memory allocation failed for key table");
+        ok = 0;
+    }
+    c->keysCopied = st->keys.count;
+    return ok;
+}
+
+static int jobCount(const J2RConverter* c) {
+    return c->options.jobs > 0 ? c->options.jobs : parallelJobCount();
+}
+
+// Converts the complete lines at the start of the pending input.
+static int convertLines(J2RConverter* c, size_t len) {
+    int lines = 0;
+    for (const char* p = c->pending; (p = memchr(p, '\n', (size_t)(c->pending + len - p))); p++) {
+        lines++;
+    }
+    int ok = ndjsonConvert(&c->symbols, c->pending, len, jobCount(c), c->nextLine);
+    c->nextLine += lines;
+    if (!deliverRows(c)) c->failed = 1;
+    memmove(c->pending, c->pending + len, c->pendingLen - len);
+    c->pendingLen -= len;
+    return ok;
+}
+
+// Appends input. NDJSON lines completed by it are converted and their rows
+// delivered before it returns. Returns 0 if a line was invalid (the others
+// are still converted) or the conversion stopped.
+int j2rFeed(J2RConverter* c, const void* data, size_t len) {
+    if (c->failed) return 0;
+    if (c->pendingLen + len > c->pendingCap) {
+        size_t cap = c->pendingCap ? c->pendingCap : 64 * 1024;
+        while (cap < c->pendingLen + len) cap *= 2;
+        char* pending = realloc(c->pending, cap);
+        if (!pending) {
+            logError("Memory allocation failed for input buffer");
+            c->failed = 1;
+            return 0;
+        }
+        c->pending = pending;
+        c->pendingCap = cap;
+    }
+    memcpy(c->pending + c->pendingLen, data, len);
+    size_t start = c->pendingLen;
+    c->pendingLen += len;
+    if (!c->options.ndjson) return 1;
+
+    // Bytes pending from earlier feeds hold no newline
+    const char* last = NULL;
+    for (size_t i = c->pendingLen; i > start; i--) {
+        if (c->pending[i - 1] == '\n') {
+            last = c->pending + i - 1;
+            break;
+        }
+    }
+    if (!last) return 1;
+    int ok = convertLines(c, (size_t)(last - c->pending) + 1);
+    return ok && !c->failed;
+}
+
+// Converts the rest of the input and delivers its rows. Returns 0 if the
+// input was invalid or the conversion stopped.
+int j2rFinish(J2RConverter* c) {
+    if (c->failed) return 0;
+    if (c->options.ndjson) {
+        int ok = c->pendingLen == 0 || convertLines(c, c->pendingLen);
+        return ok && !c->failed;
+    }
+
+    int converted;
+    if (c->options.stream) {
+        converted = streamConvert(&c->symbols, c->pending, c->pendingLen, jobCount(c));
+    } else {
+        ParseContext parse;
+        parseInit(&parse);
+        converted = parseDocument(&parse, c->pending, c->pendingLen, &c->symbols.keys, jobCount(c)) == 0 && parse.root;
+        if (converted) walkDocument(&c->symbols, parse.root, jobCount(c));
+        parseFree(&parse);
+    }
+    if (converted && !deliverRows(c)) c->failed = 1;
+    c->pendingLen = 0;
+    return converted && !c->failed;
+}
+
+void j2rFree(J2RConverter* c) {
+    if (!c) return;
+    for (int i = 0; i < c->tableCount; i++) {
+        for (int k = 0; k < c->tables[i].columnCount; k++) {
+            free(c->tables[i].columns[k]);
+        }
+        free(c->tables[i].columns);
+    }
+    free(c->tables);
+    free(c->values);
+    free(c->pending);
+    freeSymbolTables(&c->symbols);
+    free(c);
+}
@@ -0,0 +1,101 @@
+#ifndef JSON2RELCSV_H
+#define JSON2RELCSV_H
+
+// Library interface: converts JSON into the same tables the command line
+// tool writes, handing each finished row to a sink instead of writing CSV
+// files. Link with libjson2relcsv.a (see README).
+//
+//   J2RConverter* c = j2rCreate(&options, &sink);
+//   j2rFeed(c, data, len);      // as often as input arrives
+//   j2rFinish(c);               // delivers whatever is left
+//   j2rFree(c);
+//
+// A single document is converted by j2rFinish(). With options.ndjson set,
+// each j2rFeed() converts the lines it completes and delivers their rows
+// before returning, so memory stays bounded by the longest line.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The library is built with -fvisibility=hidden; only these names are
+// exported from it.
+#if defined(__GNUC__)
+#define J2R_API __attribute__((visibility("default")))
+#else
+#define J2R_API
+#endif
+
+typedef enum {
+    J2R_NULL,
+    J2R_INT,
+    J2R_DOUBLE,
+    J2R_BOOL,
+    J2R_STRING,
+    J2R_UINT
+} J2RType;
+
+// One cell. Strings are not NUL-terminated and only valid during the
+// callback; nested objects and arrays show up as empty strings, as in CSV.
+// Numbers are J2R_INT when they are integers that fit int64_t, J2R_UINT
+// when they only fit uint64_t, and J2R_DOUBLE (correctly rounded)
+// otherwise.
+typedef struct {
+    J2RType type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        int b;
+        struct {
+            const char* ptr;
+            size_t len;
+        } s;
+    } as;
+} J2RValue;
+
+typedef struct {
+    int index;              // Tables are numbered 0, 1, ... as they first get rows
+    const char* name;       // Table name, as the CSV file would be named
+    const char* parentName; // Table that parent ids refer to, NULL if none
+    const char* const* columns; // Column names; id and parent id come first and are not listed
+    int columnCount;
+} J2RTable;
+
+typedef struct {
+    int64_t id;
+    int64_t parentId;       // 0 for rows without a parent
+    const J2RValue* values; // One per column of the table
+} J2RRow;
+
+// Callbacks return 0 to stop the conversion; j2rFeed() and j2rFinish()
+// then return 0 as well. table() is called before the first row of a
+// table and again whenever the table gains columns.
+typedef struct {
+    int (*table)(void* ctx, const J2RTable* table);
+    int (*row)(void* ctx, const J2RTable* table, const J2RRow* row);
+    void* ctx;
+} J2RSink;
+
+typedef struct {
+    int ndjson;             // Input holds one document per line
+    int stream;             // Convert without building ASTs
+    int jobs;               // Threads for NDJSON lines, indexing and records; 0 means one per CPU
+} J2ROptions;
+
+typedef struct J2RConverter J2RConverter;
+
+// options may be NULL for the defaults. Returns NULL if out of memory.
+J2R_API J2RConverter* j2rCreate(const J2ROptions* options, const J2RSink* sink);
+J2R_API int j2rFeed(J2RConverter* c, const void* data, size_t len);
+J2R_API int j2rFinish(J2RConverter* c);
+J2R_API void j2rFree(J2RConverter* c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "log.h"
+#include "number.h"
+#include "parallel.h"
+#include "utf8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LEXER_X86 1
+#endif
+
+// Two-stage tokenizer. Stage 1 classifies the whole input 64 bytes at a
+// time and records one bit per token start (structural characters, opening
+// quotes of strings and first bytes of scalars) after resolving escapes and
+// string boundaries; it also validates the UTF-8 of each block. Stage 2
+// walks those bits and hands tokens to yyparse().
+
+LexerMode lexerMode = LEXER_SIMD;
+
+typedef struct {
+    uint64_t quote;     // '"'
+    uint64_t backslash; // '\\'
+    uint64_t op;        // { } [ ] : ,
+    uint64_t space;     // ' ' \t \n \r
+} BlockClass;
+
+typedef void (*ClassifyFn)(const unsigned char* p, BlockClass* c);
+
+static void classifyScalar(const unsigned char* p, BlockClass* c) {
+    c->quote = c->backslash = c->op = c->space = 0;
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = 1ULL << i;
+        switch (p[i]) {
+            case '"': c->quote |= bit; break;
+            case '\\': c->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                c->op |= bit; break;
+            case ' ': case '\t': case '\n': case '\r':
+                c->space |= bit; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef LEXER_X86
+__attribute__((target("sse4.2")))
+static void classifySse(const unsigned char* p, BlockClass* c) {
+    c->quote = c->backslash = c->op = c->space = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 16));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']'))));
+        op = _mm_or_si128(op, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                           _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i sp = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        int shift = i * 16;
+        c->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        c->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+        c->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+        c->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(sp) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static void classifyAvx2(const unsigned char* p, BlockClass* c) {
+    c->quote = c->backslash = c->op = c->space = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i * 32));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(']'))));
+        op = _mm256_or_si256(op, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i sp = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        int shift = i * 32;
+        c->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        c->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        c->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        c->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(sp) << shift;
+    }
+}
+#endif
+
+static ClassifyFn pickClassifier(void) {
+#ifdef LEXER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return classifyAvx2;
+    if (__builtin_cpu_supports("sse4.2")) return classifySse;
+#endif
+    return classifyScalar;
+}
+
+static uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Returns the bits of characters preceded by an odd-length run of
+// backslashes. prevEndsOdd carries a run that spills into the next block.
+static uint64_t findEscaped(uint64_t bs, uint64_t* prevEndsOdd) {
+    const uint64_t even = 0x5555555555555555ULL;
+    const uint64_t odd = ~even;
+    uint64_t startEdges = bs & ~(bs << 1);
+    uint64_t evenStartMask = even ^ *prevEndsOdd;
+    uint64_t evenStarts = startEdges & evenStartMask;
+    uint64_t oddStarts = startEdges & ~evenStartMask;
+    uint64_t evenCarries = bs + evenStarts;
+    uint64_t oddCarries;
+    int endsOdd = __builtin_add_overflow(bs, oddStarts, &oddCarries);
+    oddCarries |= *prevEndsOdd;
+    *prevEndsOdd = (uint64_t)endsOdd;
+    uint64_t evenCarryEnds = evenCarries & ~bs;
+    uint64_t oddCarryEnds = oddCarries & ~bs;
+    return (evenCarryEnds & odd) | (oddCarryEnds & even);
+}
+
+// Stage 1 state carried from one 64-byte block to the next.
+typedef struct {
+    uint64_t escapeCarry;   // The block ended inside an odd backslash run
+    uint64_t inString;      // All ones if the block ended inside a string
+    uint64_t scalarCarry;   // The block ended inside a scalar
+    uint64_t lastPlain;     // Its last byte was no operator, space or quote
+} IndexState;
+
+// Runs stage 1 over input words [first, end), which must lie in lx->bits,
+// starting from *state.
+// *badWord is lowered to the first block with invalid UTF-8.
+static void indexWords(Lexer* lx, ClassifyFn classify, Utf8BlockFn checkUtf8, size_t first, size_t end,
+                       IndexState* state, size_t* badWord) {
+    unsigned char copy[3 + 64];
+    for (size_t w = first; w < end; w++) {
+        const unsigned char* p = (const unsigned char*)lx->buf + w * 64;
+        if (w == 0 || w * 64 + 64 > lx->len) {
+            // The UTF-8 check reads the three bytes before the block, and
+            // the last partial block is padded with whitespace so it never
+            // produces token starts past the end of the input.
+            size_t n = lx->len - w * 64 < 64 ? lx->len - w * 64 : 64;
+            memset(copy, ' ', sizeof(copy));
+            if (w > 0) memcpy(copy, p - 3, 3);
+            memcpy(copy + 3, p, n);
+            p = copy + 3;
+        }
+
+        BlockClass c;
+        classify(p, &c);
+        lx->escapes[w - lx->base] = c.backslash != 0;
+        if (checkUtf8(p) && w < *badWord) *badWord = w;
+
+        uint64_t escaped = findEscaped(c.backslash, &state->escapeCarry);
+        uint64_t quote = c.quote & ~escaped;
+        uint64_t str = prefixXor(quote) ^ state->inString;
+        state->inString = (uint64_t)((int64_t)str >> 63);
+
+        uint64_t plain = ~(c.op | c.space | quote);
+        uint64_t scalar = plain & ~str;
+        uint64_t scalarStart = scalar & ~((scalar << 1) | state->scalarCarry);
+        state->scalarCarry = scalar >> 63;
+        state->lastPlain = plain >> 63;
+
+        lx->bits[w - lx->base] = (c.op & ~str) | (quote & str) | scalarStart;
+    }
+}
+
+// Large inputs are indexed in ranges of at least this many words (1 MiB).
+#define LEXER_MIN_RANGE_WORDS 16384
+
+// Decoded strings are rare enough that small arena blocks do.
+#define LEXER_STRING_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    Lexer* lx;
+    ClassifyFn classify;
+    Utf8BlockFn checkUtf8;
+    size_t badWord;     // First block with invalid UTF-8, SIZE_MAX if none
+    size_t first;       // First word of the range
+    size_t end;         // One past its last word
+    IndexState start;   // State the range is indexed from
+    IndexState after;   // State after the range
+    int redo;           // start was wrong on the first pass
+} IndexRange;
+
+static void indexRange(void* ctx, int index) {
+    IndexRange* r = &((IndexRange*)ctx)[index];
+    r->after = r->start;
+    indexWords(r->lx, r->classify, r->checkUtf8, r->first, r->end, &r->after, &r->badWord);
+}
+
+// Indexes input words [first, end) from *state, which receives the state
+// after them. Every range is indexed in parallel as if it started outside
+// any string, escape or scalar, then the real state at each boundary is
+// worked out from the one before it. A boundary inside a string only flips the range's
+// string state, so the state after it follows without rescanning; ranges
+// that started from a wrong state are indexed again, in parallel once all
+// boundaries are known. A boundary inside a backslash run can change
+// which quotes count, so that (rare) range is redone on the spot.
+static size_t indexSpeculative(Lexer* lx, ClassifyFn classify, Utf8BlockFn checkUtf8, IndexRange* ranges,
+                               int count, int jobs, size_t first, size_t end, IndexState* state0) {
+    for (int k = 0; k < count; k++) {
+        ranges[k].lx = lx;
+        ranges[k].classify = classify;
+        ranges[k].checkUtf8 = checkUtf8;
+        ranges[k].badWord = SIZE_MAX;
+        ranges[k].first = first + (end - first) * k / count;
+        ranges[k].end = first + (end - first) * (k + 1) / count;
+        memset(&ranges[k].start, 0, sizeof(IndexState));
+        ranges[k].redo = 0;
+    }
+    ranges[0].start = *state0;
+    parallelFor(count, jobs, indexRange, ranges);
+
+    // UTF-8 does not depend on the state, so the first pass has found
+    // every invalid block
+    size_t badWord = SIZE_MAX;
+    for (int k = 0; k < count; k++) {
+        if (ranges[k].badWord < badWord) badWord = ranges[k].badWord;
+    }
+
+    IndexState state = ranges[0].after;
+    for (int k = 1; k < count; k++) {
+        IndexRange* r = &ranges[k];
+        if (state.escapeCarry) {
+            r->start = state;
+            indexRange(ranges, k);
+            state = r->after;
+            continue;
+        }
+        IndexState after = r->after;
+        after.inString ^= state.inString;
+        after.scalarCarry = after.lastPlain & ~after.inString & 1;
+        if (state.inString || state.scalarCarry) {
+            r->start = state;
+            r->redo = 1;
+        }
+        state = after;
+    }
+
+    *state0 = state;
+
+    int redoCount = 0;
+    for (int k = 0; k < count; k++) {
+        if (ranges[k].redo) ranges[redoCount++] = ranges[k];
+    }
+    parallelFor(redoCount, jobs, indexRange, ranges);
+    return badWord;
+}
+
+// Reports the first ill-formed byte at or before the end of block w.
+// Checking starts a few bytes early, at the sequence the block's first
+// byte belongs to, since that sequence may be what is wrong.
+static void reportUtf8Error(const Lexer* lx, size_t w) {
+    size_t start = w * 64 >= 3 ? w * 64 - 3 : 0;
+    for (int k = 0; k < 3 && start > 0 && ((unsigned char)lx->buf[start] & 0xC0) == 0x80; k++) start--;
+    size_t offset = start + utf8Validate(lx->buf + start, lx->len - start);
+    int line, col;
+    lexerPosition(lx, offset, &line, &col);
+    logError("Invalid UTF-8 at line %d, col %d", line, col);
+}
+
+// Indexing of the input, all at once or a window at a time.
+typedef struct LexerWindow {
+    ClassifyFn classify;
+    Utf8BlockFn checkUtf8;
+    IndexState state;   // State after the last indexed word
+    size_t words;       // Words per window
+    size_t tokens;      // Token starts indexed so far
+    int jobs;
+    int failed;         // A window held invalid UTF-8
+} LexerWindow;
+
+// Indexes input words [first, end) into bits, on up to jobs threads once
+// there are several MiB of them. Returns 0 after reporting invalid UTF-8.
+static int indexBlock(Lexer* lx, LexerWindow* win, size_t first, size_t end) {
+    size_t badWord = SIZE_MAX;
+    size_t rangeCount = (end - first) / LEXER_MIN_RANGE_WORDS;
+    if (rangeCount > (size_t)win->jobs) rangeCount = (size_t)win->jobs;
+    IndexRange* ranges = rangeCount > 1 ? calloc(rangeCount, sizeof(IndexRange)) : NULL;
+    if (ranges) {
+        badWord = indexSpeculative(lx, win->classify, win->checkUtf8, ranges, (int)rangeCount, win->jobs,
+                                   first, end, &win->state);
+        free(ranges);
+    } else {
+        indexWords(lx, win->classify, win->checkUtf8, first, end, &win->state, &badWord);
+    }
+
+    // Blocks leave a sequence cut off at their end to the next one; the
+    // last block has none
+    if (badWord == SIZE_MAX && end == lx->wordCount && lx->len % 64 == 0 && lx->len) {
+        size_t start = lx->len - 3;
+        while (start > 0 && ((unsigned char)lx->buf[start] & 0xC0) == 0x80) start--;
+        if (utf8Validate(lx->buf + start, lx->len - start) != lx->len - start) badWord = lx->wordCount - 1;
+    }
+    if (badWord != SIZE_MAX) {
+        reportUtf8Error(lx, badWord);
+        return 0;
+    }
+    return 1;
+}
+
+static int startIndex(Lexer* lx, LexerWindow* win, const char* buf, size_t len, int jobs, size_t words) {
+    memset(lx, 0, sizeof(*lx));
+    lx->buf = buf;
+    lx->len = len;
+    lx->wordCount = (len + 63) / 64;
+    if (words > lx->wordCount) words = lx->wordCount;
+    lx->bits = malloc(sizeof(uint64_t) * (words ? words : 1));
+    lx->escapes = malloc(words ? words : 1);
+    arenaInit(&lx->strings, LEXER_STRING_BLOCK_SIZE);
+    if (!lx->bits || !lx->escapes) {
+        logError("Memory allocation failed for structural index");
+        return 0;
+    }
+    win->classify = pickClassifier();
+    win->checkUtf8 = utf8PickBlockCheck();
+    win->words = words;
+    win->jobs = jobs;
+    lx->indexed = words;
+    if (!indexBlock(lx, win, 0, words)) return 0;
+    lx->cur = lx->wordCount ? lx->bits[0] : 0;
+    return 1;
+}
+
+// Indexes buf. Inputs of several MiB are indexed on up to jobs threads;
+// callers already running on a pool pass 1.
+int lexerInit(Lexer* lx, const char* buf, size_t len, int jobs) {
+    LexerWindow win;
+    memset(&win, 0, sizeof(win));
+    if (!startIndex(lx, &win, buf, len, jobs, (len + 63) / 64)) {
+        lexerFree(lx);
+        return 0;
+    }
+    return 1;
+}
+
+// Like lexerInit(), but indexes 1 MiB of input per job at a time, as
+// tokens are consumed, so the index takes the same memory whatever the
+// input size. Invalid UTF-8 is reported when its window is reached, and
+// decoded strings only live until the next window is indexed.
+int lexerInitWindowed(Lexer* lx, const char* buf, size_t len, int jobs) {
+    LexerWindow* win = calloc(1, sizeof(LexerWindow));
+    if (!win) {
+        logError("Memory allocation failed for structural index");
+        return 0;
+    }
+    int ok = startIndex(lx, win, buf, len, jobs, (size_t)LEXER_MIN_RANGE_WORDS * (size_t)jobs);
+    lx->window = win;
+    if (!ok) {
+        lexerFree(lx);
+        return 0;
+    }
+    for (size_t w = 0; w < lx->indexed; w++) {
+        win->tokens += (size_t)__builtin_popcountll(lx->bits[w]);
+    }
+    return 1;
+}
+
+// Replaces the window with the words after it, once the lexer has
+// consumed every token start in it. Returns 0 at the end of the input or
+// if the new window is invalid.
+static int nextWindow(Lexer* lx) {
+    LexerWindow* win = lx->window;
+    if (!win || win->failed || lx->indexed >= lx->wordCount) return 0;
+    size_t first = lx->indexed;
+    size_t end = first + win->words < lx->wordCount ? first + win->words : lx->wordCount;
+    lx->base = first;
+    lx->indexed = end;
+    arenaReset(&lx->strings);
+    if (!indexBlock(lx, win, first, end)) {
+        win->failed = 1;
+        lx->indexed = first;
+        return 0;
+    }
+    for (size_t w = 0; w < end - first; w++) {
+        win->tokens += (size_t)__builtin_popcountll(lx->bits[w]);
+    }
+    return 1;
+}
+
+// Number of tokens in the input; for a windowed lexer, in the windows
+// indexed so far.
+size_t lexerTokenCount(const Lexer* lx) {
+    if (lx->window) return lx->window->tokens;
+    size_t count = 0;
+    for (size_t w = 0; w < lx->wordCount; w++) {
+        count += (size_t)__builtin_popcountll(lx->bits[w]);
+    }
+    return count;
+}
+
+int lexerFailed(const Lexer* lx) {
+    return lx->window && lx->window->failed;
+}
+
+void lexerFree(Lexer* lx) {
+    free(lx->bits);
+    free(lx->escapes);
+    free(lx->window);
+    arenaFree(&lx->strings);
+    lx->bits = NULL;
+    lx->escapes = NULL;
+    lx->window = NULL;
+    lx->wordCount = 0;
+    lx->base = lx->indexed = 0;
+    lx->cur = 0;
+}
+
+static int popStart(Lexer* lx, size_t* pos) {
+    while (lx->cur == 0) {
+        if (++lx->word >= lx->indexed && !nextWindow(lx)) {
+            lx->word = lx->wordCount;
+            return 0;
+        }
+        lx->cur = lx->bits[lx->word - lx->base];
+    }
+    *pos = lx->word * 64 + (size_t)__builtin_ctzll(lx->cur);
+    lx->cur &= lx->cur - 1;
+    return 1;
+}
+
+static size_t peekStart(Lexer* lx) {
+    uint64_t cur = lx->cur;
+    size_t word = lx->word;
+    while (cur == 0) {
+        if (++word >= lx->indexed) {
+            // Nothing in the window is left to consume, so the lexer can
+            // move on to the next one
+            if (!nextWindow(lx)) return lx->len;
+            lx->word = lx->base - 1;
+            lx->cur = 0;
+        }
+        cur = lx->bits[word - lx->base];
+    }
+    return word * 64 + (size_t)__builtin_ctzll(cur);
+}
+
+static int isDelimiter(const Lexer* lx, size_t pos) {
+    if (pos >= lx->len) return 1;
+    switch (lx->buf[pos]) {
+        case ' ': case '\t': case '\n': case '\r':
+        case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int lexError(Lexer* lx, const char* message) {
+    int errLine, errCol;
+    lexerPosition(lx, lx->tokStart, &errLine, &errCol);
+    size_t shown = lx->tokEnd - lx->tokStart;
+    if (shown > 32) shown = 32;
+    logError("%s '%.*s' at line %d, col %d",
+             message, (int)shown, lx->buf + lx->tokStart, errLine, errCol);
+    return YYUNDEF;
+}
+
+// Most strings have no escapes and are returned as slices of the input.
+// Stage 1 noted the blocks that hold a backslash, so that is known
+// without looking at the string's bytes again.
+static int hasEscapes(const Lexer* lx, size_t start, size_t end) {
+    // A string that started in an earlier window has to be searched
+    if (start / 64 < lx->base) return 1;
+    for (size_t w = start / 64; w <= end / 64 && w < lx->indexed; w++) {
+        if (lx->escapes[w - lx->base]) return 1;
+    }
+    return 0;
+}
+
+static int lexString(Lexer* lx, size_t pos, YYSTYPE* lval) {
+    // The closing quote is the last non-blank byte before the next token.
+    size_t next = peekStart(lx);
+    if (lx->window && lx->window->failed) return YYUNDEF;
+    size_t end = next;
+    while (end > pos + 1 && (lx->buf[end - 1] == ' ' || lx->buf[end - 1] == '\t' ||
+                             lx->buf[end - 1] == '\n' || lx->buf[end - 1] == '\r')) {
+        end--;
+    }
+    lx->tokEnd = end;
+    if (end < pos + 2 || lx->buf[end - 1] != '"') {
+        return lexError(lx, "Unterminated string");
+    }
+
+    const char* body = lx->buf + pos + 1;
+    size_t n = end - pos - 2;
+    if (n > SLICE_MAX_LEN) {
+        return lexError(lx, "String longer than 4 GiB");
+    }
+    Slice* text = &lval->str.text;
+    text->ptr = body;
+    text->len = (uint32_t)n;
+    text->flags = 0;
+    lval->str.keyId = -1;
+    if (hasEscapes(lx, pos + 1, end - 1) && memchr(body, '\\', n)) {
+        char* decoded = arenaAlloc(&lx->strings, n ? n : 1);
+        if (!decoded) return YYUNDEF;
+        size_t errAt;
+        long len = jsonUnescape(body, n, decoded, &errAt);
+        if (len < 0) {
+            lx->tokStart = pos + 1 + errAt;
+            return lexError(lx, "Invalid escape");
+        }
+        text->ptr = decoded;
+        text->len = (uint32_t)len;
+        text->flags = SLICE_TRANSIENT;
+    }
+
+    // A string followed by a colon is a key. Its bytes were just read, so
+    // it is hashed and interned here rather than again for every row.
+    if (lx->keys && next < lx->len && lx->buf[next] == ':') {
+        lval->str.keyId = internSlice(lx->keys, *text);
+        if (lval->str.keyId < 0) return YYUNDEF;
+    }
+    return STRING;
+}
+
+static int lexScalar(Lexer* lx, size_t pos, YYSTYPE* lval) {
+    const char* p = lx->buf + pos;
+    size_t end = pos;
+    while (!isDelimiter(lx, end)) end++;
+    lx->tokEnd = end;
+    size_t n = end - pos;
+
+    if (n == 4 && memcmp(p, "true", 4) == 0) {
+        lval->boolVal = 1;
+        return TRUE;
+    }
+    if (n == 5 && memcmp(p, "false", 5) == 0) {
+        lval->boolVal = 0;
+        return FALSE;
+    }
+    if (n == 4 && memcmp(p, "null", 4) == 0) {
+        return NULLTOK;
+    }
+
+    // Numbers stay text until something needs their value
+    if (n > SLICE_MAX_LEN) return lexError(lx, "Token longer than 4 GiB");
+    if (!numberValid(p, n)) return lexError(lx, "Invalid token");
+    lval->strVal.ptr = p;
+    lval->strVal.len = (uint32_t)n;
+    lval->strVal.flags = 0;
+    return NUMBER;
+}
+
+int lexerNext(Lexer* lx, YYSTYPE* lval) {
+    size_t pos;
+    if (!popStart(lx, &pos)) {
+        lx->tokStart = lx->tokEnd = lx->len;
+        return lx->window && lx->window->failed ? YYUNDEF : YYEOF;
+    }
+
+    lx->tokStart = pos;
+    lx->tokEnd = pos + 1;
+    switch (lx->buf[pos]) {
+        case '{': return LEFT_BRACE;
+        case '}': return RIGHT_BRACE;
+        case '[': return LEFT_BRACKET;
+        case ']': return RIGHT_BRACKET;
+        case ':': return COLON;
+        case ',': return COMMA;
+        case '"': return lexString(lx, pos, lval);
+        default: return lexScalar(lx, pos, lval);
+    }
+}
+
+void lexerPosition(const Lexer* lx, size_t offset, int* line, int* col) {
+    // Only used for diagnostics, so counting lines here keeps the hot
+    // path free of per-token bookkeeping.
+    int l = 1;
+    size_t lineStart = 0;
+    const char* p = lx->buf;
+    const char* end = lx->buf + (offset < lx->len ? offset : lx->len);
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        l++;
+        p++;
+        lineStart = (size_t)(p - lx->buf);
+    }
+    *line = l;
+    *col = (int)(offset - lineStart) + 1;
+}
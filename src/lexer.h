@@ -0,0 +1,42 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "intern.h"
+#include "parser.tab.h"
+
+typedef enum {
+    LEXER_SIMD,         // Structural-index lexer (default)
+    LEXER_FLEX          // Original flex scanner, kept for A/B comparison
+} LexerMode;
+
+typedef struct Lexer {
+    const char* buf;    // Whole input, must stay alive while lexing
+    size_t len;         // Input length in bytes
+    uint64_t* bits;     // One bit per input byte marking token starts, from word base on
+    uint8_t* escapes;   // One byte per 64-byte block, set if it holds a backslash
+    size_t wordCount;   // Number of 64-bit words in the input
+    size_t base;        // Input word held in bits[0]
+    size_t indexed;     // One past the last input word in bits
+    struct LexerWindow* window; // Set if the input is indexed a window at a time
+    size_t word;        // Index of the word being consumed
+    uint64_t cur;       // Remaining (unconsumed) bits of bits[word]
+    size_t tokStart;    // Offset of the last token returned
+    size_t tokEnd;      // Offset one past the last token returned
+    Arena strings;      // Strings with escapes, decoded (SLICE_TRANSIENT); windowed, only until the next window
+    Interner* keys;     // Object keys are interned here as they are lexed, if set
+} Lexer;
+
+extern LexerMode lexerMode;
+
+int lexerInit(Lexer* lx, const char* buf, size_t len, int jobs);
+int lexerInitWindowed(Lexer* lx, const char* buf, size_t len, int jobs);
+int lexerNext(Lexer* lx, YYSTYPE* lval);
+void lexerPosition(const Lexer* lx, size_t offset, int* line, int* col);
+size_t lexerTokenCount(const Lexer* lx);
+int lexerFailed(const Lexer* lx);   // A later window held invalid UTF-8, already reported
+void lexerFree(Lexer* lx);
+
+#endif
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "log.h"
+
+LogLevel logLevel = LOG_LEVEL_WARN;
+__thread char* logFirstError;
+static __thread size_t firstErrorCap;
+
+static const char* const levelNames[] = { "off", "error", "warn", "info", "debug", "trace" };
+static const char* const levelPrefixes[] = { "", "Error", "Warning", "Info", "Debug", "Trace" };
+
+// Keeps the first error logged on the calling thread in buf, whatever
+// logLevel is, until called again with NULL. The server answers failed
+// requests with it.
+void logCaptureErrors(char* buf, size_t cap) {
+    logFirstError = cap ? buf : NULL;
+    firstErrorCap = cap;
+    if (logFirstError) logFirstError[0] = '\0';
+}
+
+// Writes one line. The stream is locked for the whole line so that lines
+// from different threads do not interleave.
+void logMessage(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (level == LOG_LEVEL_ERROR && logFirstError && !logFirstError[0]) {
+        va_list copy;
+        va_copy(copy, args);
+        vsnprintf(logFirstError, firstErrorCap, format, copy);
+        va_end(copy);
+    }
+    if (level > logLevel) {
+        va_end(args);
+        return;
+    }
+    flockfile(stderr);
+    fprintf(stderr, "%s: ", levelPrefixes[level]);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+    va_end(args);
+}
+
+const char* logLevelName(LogLevel level) {
+    return levelNames[level];
+}
+
+// Parses a --log-level argument. Returns 0 for an unknown name.
+int logParseLevel(const char* name, LogLevel* level) {
+    for (int i = LOG_LEVEL_OFF; i <= LOG_LEVEL_TRACE; i++) {
+        if (strcmp(name, levelNames[i]) == 0) {
+            *level = (LogLevel)i;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+
+// Leveled diagnostics on stderr. Messages above LOG_MAX_LEVEL are compiled
+// out, level check and arguments included, so release builds (-DNDEBUG,
+// or -DLOG_MAX_LEVEL=n) pay nothing for the per-token and per-node ones.
+// The rest are filtered at run time against logLevel (--log-level).
+
+typedef enum {
+    LOG_LEVEL_OFF,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_TRACE     // Per token and per AST node
+} LogLevel;
+
+#ifndef LOG_MAX_LEVEL
+#ifdef NDEBUG
+#define LOG_MAX_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MAX_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+extern LogLevel logLevel;   // Default LOG_LEVEL_WARN
+extern __thread char* logFirstError;    // Set by logCaptureErrors()
+
+void logMessage(LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void logCaptureErrors(char* buf, size_t cap);
+int logParseLevel(const char* name, LogLevel* level);
+const char* logLevelName(LogLevel level);
+
+// Errors are also formatted when they are only being captured.
+#define LOG_AT(level, ...) \
+    do { \
+        if ((level) <= LOG_MAX_LEVEL && \
+            ((level) <= logLevel || ((level) == LOG_LEVEL_ERROR && logFirstError))) { \
+            logMessage((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define logError(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define logWarn(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define logInfo(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define logDebug(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define logTrace(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+
+#endif
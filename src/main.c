@@ -1,17 +1,45 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "ast.h"
 #include "symbol_table.h"
 #include "csv-writer.h"
-
-extern int yyparse();
-extern ASTNode* rootNode;
+#include "lexer.h"
+#include "input.h"
+#include "log.h"
+#include "parallel.h"
+#include "stream.h"
+#include "ndjson.h"
+#include "parse.h"
+#include "batch.h"
+#include "server.h"
+#include "stats.h"
 
 int main(int argc, char** argv) {
     int printAst = 0;
     int printSymbolTbl = 0;
     char* outDir = NULL;
     char* inputFile = NULL;
+    int exitCode = 0;
+    int streamMode = 0;
+    int ndjsonMode = 0;
+    int batchMode = 0;
+    int batchMerge = 0;
+    BatchInputs batchInputs = {0};
+    char* servePath = NULL;
+    int statsText = 0;
+    char* statsJsonPath = NULL;
+    SymbolTable symbols;
+    ParseContext parse;
+
+    // Batch options change what plain arguments mean, wherever they are
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 || strcmp(argv[i], "--merge") == 0 ||
+            strcmp(argv[i], "--file-list") == 0) {
+            batchMode = 1;
+        }
+    }
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--print-ast") == 0) {
@@ -25,6 +53,80 @@ int main(int argc, char** argv) {
                 fprintf(stderr, "Error: --out-dir requires a directory argument\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "--lexer") == 0) {
+            if (i + 1 < argc && strcmp(argv[i + 1], "simd") == 0) {
+                lexerMode = LEXER_SIMD;
+            } else if (i + 1 < argc && strcmp(argv[i + 1], "flex") == 0) {
+                lexerMode = LEXER_FLEX;
+            } else {
+                fprintf(stderr, "Error: --lexer requires 'simd' or 'flex'\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streamMode = 1;
+        } else if (strcmp(argv[i], "--ndjson") == 0) {
+            ndjsonMode = 1;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            // Checked above
+        } else if (strcmp(argv[i], "--merge") == 0) {
+            batchMerge = 1;
+        } else if (strcmp(argv[i], "--file-list") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --file-list requires a file argument\n");
+                return 1;
+            }
+            if (!batchReadList(&batchInputs, argv[++i])) {
+                batchFreeInputs(&batchInputs);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --serve requires a socket path\n");
+                return 1;
+            }
+            servePath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsText = 1;
+        } else if (strcmp(argv[i], "--stats-json") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --stats-json requires a file argument ('-' for stdout)\n");
+                return 1;
+            }
+            statsJsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--log-level") == 0) {
+            if (i + 1 >= argc || !logParseLevel(argv[i + 1], &logLevel)) {
+                fprintf(stderr, "Error: --log-level requires off, error, warn, info, debug or trace\n");
+                return 1;
+            }
+            if (logLevel > LOG_MAX_LEVEL) {
+                fprintf(stderr, "Warning: Messages above level %s are compiled out of this build\n",
+                        logLevelName(LOG_MAX_LEVEL));
+            }
+            i++;
+        } else if (strcmp(argv[i], "--always-quote") == 0) {
+            csvAlwaysQuote = 1;
+        } else if (strcmp(argv[i], "--jobs") == 0) {
+            int jobs = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+            if (jobs < 1) {
+                fprintf(stderr, "Error: --jobs requires a positive thread count\n");
+                return 1;
+            }
+            parallelJobs = jobs;
+            i++;
+        } else if (strcmp(argv[i], "--write-buffer") == 0) {
+            int mib = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+            if (mib < 1 || mib > 64) {
+                fprintf(stderr, "Error: --write-buffer requires a size in MiB between 1 and 64\n");
+                return 1;
+            }
+            csvBufferSize = (size_t)mib << 20;
+            i++;
+        } else if (argv[i][0] != '-' && batchMode) {
+            if (!batchAddInput(&batchInputs, argv[i])) {
+                batchFreeInputs(&batchInputs);
+                return 1;
+            }
         } else if (argv[i][0] != '-') {
             if (inputFile) {
                 fprintf(stderr, "Error: Only one input file can be specified\n");
@@ -36,50 +138,170 @@ int main(int argc, char** argv) {
         }
     }
 
-    FILE* input = stdin;
-    if (inputFile) {
-        input = fopen(inputFile, "r");
-        if (!input) {
-            fprintf(stderr, "Error: Could not open input file '%s'\n", inputFile);
+    if (streamMode && lexerMode != LEXER_SIMD) {
+        fprintf(stderr, "Error: --stream requires the simd lexer\n");
+        return 1;
+    }
+    if (ndjsonMode && lexerMode != LEXER_SIMD) {
+        fprintf(stderr, "Error: --ndjson requires the simd lexer\n");
+        return 1;
+    }
+    if (streamMode && printAst) {
+        fprintf(stderr, "Warning: --print-ast has no effect with --stream\n");
+    }
+    if (ndjsonMode && printAst) {
+        fprintf(stderr, "Warning: --print-ast has no effect with --ndjson\n");
+    }
+
+    if ((statsText || statsJsonPath) && (servePath || batchMode)) {
+        fprintf(stderr, "Warning: --stats has no effect with --batch or --serve\n");
+    } else if (statsText || statsJsonPath) {
+        statsEnabled = 1;
+    }
+    if (statsJsonPath && strcmp(statsJsonPath, "-") == 0) {
+        if (printAst || printSymbolTbl) {
+            fprintf(stderr, "Error: --stats-json - cannot be combined with --print-ast or --print-symbol-table\n");
+            batchFreeInputs(&batchInputs);
+            return 1;
+        }
+        // stdout holds only the JSON object
+        csvPrintSaved = 0;
+    }
+
+    if (servePath) {
+        if (lexerMode != LEXER_SIMD || ndjsonMode || batchMode) {
+            fprintf(stderr, "Error: --serve requires the simd lexer and cannot be combined with --ndjson or --batch\n");
+            batchFreeInputs(&batchInputs);
             return 1;
         }
-        if (freopen(inputFile, "r", stdin) == NULL) {
-            fprintf(stderr, "Error: Failed to redirect input from '%s'\n", inputFile);
-            fclose(input);
+        return serveSocket(servePath, streamMode) ? 0 : 1;
+    }
+
+    if (batchMode) {
+        if (lexerMode != LEXER_SIMD || ndjsonMode) {
+            fprintf(stderr, "Error: --batch requires the simd lexer and cannot be combined with --ndjson\n");
+            batchFreeInputs(&batchInputs);
             return 1;
         }
-        fclose(input);
+        if (printAst) {
+            fprintf(stderr, "Warning: --print-ast has no effect with --batch\n");
+        }
+        if (printSymbolTbl && !batchMerge) {
+            fprintf(stderr, "Warning: --print-symbol-table needs --merge in batch mode\n");
+        }
+        BatchOptions options = { outDir, batchMerge, streamMode, printSymbolTbl };
+        int ok = batchConvert(&batchInputs, &options);
+        batchFreeInputs(&batchInputs);
+        return ok ? 0 : 1;
+    }
+
+    InputBuffer inputBuf = {0};
+    statsStart(STATS_READ);
+    int inputOk = inputFile ? inputOpenFile(&inputBuf, inputFile)
+                            : inputReadStream(&inputBuf, STDIN_FILENO);
+    statsStop(STATS_READ);
+    if (!inputOk) {
+        return 1;
+    }
+    j2r_stats.inputBytes = inputBuf.len;
+
+    int jobs = parallelJobCount();
+    initSymbolTable(&symbols);
+    parseInit(&parse);
+    int converted = 0;
+    CsvSpill* spill = NULL;
+    if (ndjsonMode) {
+        // Invalid lines are reported and skipped; the rest is still written
+        logInfo("Starting NDJSON conversion");
+        // Lines are lexed, parsed and walked together on the worker threads
+        statsStart(STATS_WALK);
+        if (!ndjsonConvert(&symbols, inputBuf.data, inputBuf.len, jobs, 1)) {
+            exitCode = 1;
+        }
+        statsStop(STATS_WALK);
+        converted = 1;
+    } else if (streamMode) {
+        logInfo("Starting streaming conversion");
+        if (printSymbolTbl) {
+            // The symbol table is printed with all of its rows
+            converted = streamConvert(&symbols, inputBuf.data, inputBuf.len, jobs);
+        } else {
+            // Rows go to disk as they complete instead of piling up
+            spill = csvSpillOpen(outDir);
+            converted = spill && streamConvertTo(&symbols, inputBuf.data, inputBuf.len, jobs,
+                                                 csvSpillRows, spill);
+        }
+    } else {
+        logInfo("Starting yyparse");
+        int parseResult = parseDocument(&parse, inputBuf.data, inputBuf.len, &symbols.keys, jobs);
+        logDebug("yyparse completed, result=%d, rootNode=%p", parseResult, (void*)parse.root);
+        converted = parseResult == 0 && parse.root != NULL;
     }
 
-    printf("Debug: Starting yyparse\n");
-    int parseResult = yyparse();
-    printf("Debug: yyparse completed, result=%d, rootNode=%p\n", parseResult, (void*)rootNode);
+    if (converted) {
+        if (parse.root) {
+            logDebug("Root node type=%s, childCount=%d",
+                     nodeKindName(parse.root->kind), parse.root->childCount);
 
-    if (parseResult == 0 && rootNode != NULL) {
-        printf("Debug: Root node type=%s, childCount=%d\n",
-               rootNode->type, rootNode->childCount);
+            statsStart(STATS_WALK);
+            walkDocument(&symbols, parse.root, jobs);
+            statsStop(STATS_WALK);
+            if (statsEnabled) {
+                j2r_stats.nodes = countNodes(parse.root);
+                j2r_stats.arenaAllocs = parse.arena.allocCount;
+                j2r_stats.arenaBytes = parse.arena.bytesUsed;
+                j2r_stats.arenaBlocks = parse.arena.blockCount;
+            }
 
-        walkAST(rootNode, NULL, 0);
+            if (printAst) {
+                printf("\n------------------------- AST Structure -------------------------\n\n");
+                printAST(parse.root, 0, 1);
+                printf("\n");
+            }
 
-        if (printAst) {
-            printf("\n------------------------- AST Structure -------------------------\n\n");
-            printAST(rootNode, 0, 1);
-            printf("\n");
+            logDebug("AST arena used %zu bytes in %zu blocks",
+                     parse.arena.bytesUsed, parse.arena.blockCount);
+            parseFree(&parse);
         }
 
         if (printSymbolTbl) {
             printf("\n------------------------- Symbol Table -------------------------\n\n");
-            printSymbolTables();
+            printSymbolTables(&symbols);
+        }
+
+        size_t* bytesWritten = statsEnabled ? calloc(symbols.registry.count + 1, sizeof(size_t)) : NULL;
+        statsStart(STATS_WRITE);
+        if (outDir && !saveSymbolTableToCSV(&symbols, outDir, jobs, bytesWritten)) {
+            exitCode = 1;
         }
+        statsStop(STATS_WRITE);
+        csvSpillFree(spill);
 
-        if (outDir) {
-            saveSymbolTableToCSV(outDir);
+        if (statsText) {
+            statsReport(stderr, &symbols, bytesWritten);
+        }
+        if (statsJsonPath) {
+            FILE* json = strcmp(statsJsonPath, "-") == 0 ? stdout : fopen(statsJsonPath, "w");
+            if (json) {
+                statsReportJson(json, &symbols, bytesWritten);
+                if (json != stdout) fclose(json);
+            } else {
+                logError("Could not open stats file '%s'", statsJsonPath);
+                exitCode = 1;
+            }
         }
+        free(bytesWritten);
 
     } else {
-        fprintf(stderr, "Parsing failed.\n");
+        logError("Parsing failed");
+        csvSpillFree(spill);
+        parseFree(&parse);
+        inputClose(&inputBuf);
         return 1;
     }
 
-    return 0;
+    // String slices in the symbol table point into the input, so it is
+    // released only after the CSV files are written.
+    inputClose(&inputBuf);
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ndjson.h"
+#include "log.h"
+#include "parallel.h"
+#include "stream.h"
+
+// The input is cut at newlines into a few chunks per thread. Each chunk
+// is converted into its own SymbolTable with ids starting at 1; the
+// chunks are then merged in input order, shifting each one's ids past
+// those of the chunks before it, so ids do not depend on the thread count.
+
+#define NDJSON_CHUNKS_PER_JOB 4
+
+typedef struct {
+    const char* start;
+    const char* end;
+    SymbolTable symbols;
+    int lineCount;      // Lines in the chunk
+    int* badLines;      // Chunk-relative numbers of invalid lines
+    int badCount;
+    int badCap;
+    int failed;         // Out of memory
+} Chunk;
+
+static int isBlankLine(const char* p, const char* end) {
+    for (; p < end; p++) {
+        if (*p != ' ' && *p != '\t' && *p != '\r') return 0;
+    }
+    return 1;
+}
+
+static void noteBadLine(Chunk* c, int line) {
+    if (c->badCount == c->badCap) {
+        int cap = c->badCap ? c->badCap * 2 : 8;
+        int* lines = realloc(c->badLines, sizeof(int) * cap);
+        if (!lines) {
+            c->failed = 1;
+            return;
+        }
+        c->badLines = lines;
+        c->badCap = cap;
+    }
+    c->badLines[c->badCount++] = line;
+}
+
+static void convertChunk(void* ctx, int index) {
+    Chunk* c = &((Chunk*)ctx)[index];
+    initSymbolTable(&c->symbols);
+    const char* p = c->start;
+    while (p < c->end) {
+        const char* nl = memchr(p, '\n', (size_t)(c->end - p));
+        const char* lineEnd = nl ? nl : c->end;
+        c->lineCount++;
+        if (!isBlankLine(p, lineEnd) &&
+            !streamConvertRecord(&c->symbols, p, (size_t)(lineEnd - p))) {
+            noteBadLine(c, c->lineCount);
+        }
+        p = nl ? nl + 1 : c->end;
+    }
+    sortTablesBySerial(&c->symbols);
+}
+
+int ndjsonConvert(SymbolTable* st, const char* buf, size_t len, int jobs, int firstLine) {
+    int chunkCount = jobs * NDJSON_CHUNKS_PER_JOB;
+    if ((size_t)chunkCount > len / 4096 + 1) chunkCount = (int)(len / 4096) + 1;
+    Chunk* chunks = calloc(chunkCount, sizeof(Chunk));
+    if (!chunks) {
+        logError("Memory allocation failed for NDJSON chunks");
+        return 0;
+    }
+
+    // Chunk boundaries go just past the first newline at or after each
+    // even split point.
+    const char* end = buf + len;
+    const char* p = buf;
+    int count = 0;
+    for (int k = 0; k < chunkCount && p < end; k++) {
+        const char* stop = end;
+        if (k + 1 < chunkCount) {
+            const char* target = buf + len / chunkCount * (k + 1);
+            if (target <= p) continue; // A long line ran past this split point
+            const char* nl = memchr(target - 1, '\n', (size_t)(end - target + 1));
+            if (nl) stop = nl + 1;
+        }
+        chunks[count].start = p;
+        chunks[count].end = stop;
+        count++;
+        p = stop;
+    }
+
+    parallelFor(count, jobs, convertChunk, chunks);
+
+    int ok = 1;
+    for (int i = 0; i < count; i++) {
+        Chunk* c = &chunks[i];
+        for (int k = 0; k < c->badCount; k++) {
+            logError("Skipped invalid record on line %d", firstLine + c->badLines[k] - 1);
+        }
+        if (c->badCount || c->failed) ok = 0;
+        if (!mergeSymbolTable(st, &c->symbols)) ok = 0;
+        firstLine += c->lineCount;
+        free(c->badLines);
+    }
+    free(chunks);
+    streamFinish(st);
+    return ok;
+}
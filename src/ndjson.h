@@ -0,0 +1,13 @@
+#ifndef NDJSON_H
+#define NDJSON_H
+
+#include <stddef.h>
+#include "symbol_table.h"
+
+// Converts newline-delimited JSON, one document per line, on up to jobs
+// threads. The result is the same as converting the lines one after the
+// other. Returns 0 if any line was not a valid document; the other lines
+// are still converted. Errors count lines from firstLine.
+int ndjsonConvert(SymbolTable* st, const char* buf, size_t len, int jobs, int firstLine);
+
+#endif
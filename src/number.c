@@ -0,0 +1,338 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "number.h"
+
+#define POW5_MIN (-342)     // Below this every 19-digit mantissa rounds to 0
+#define POW5_MAX 308        // Above this every mantissa overflows
+
+static inline int isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int numberValid(const char* p, size_t n) {
+    const char* end = p + n;
+    if (p < end && *p == '-') p++;
+    if (p == end || !isDigit(*p)) return 0;
+    if (*p++ == '0') {
+        if (p < end && isDigit(*p)) return 0;   // No leading zeros
+    } else {
+        while (p < end && isDigit(*p)) p++;
+    }
+    if (p < end && *p == '.') {
+        if (++p == end || !isDigit(*p)) return 0;
+        while (p < end && isDigit(*p)) p++;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) p++;
+        if (p == end || !isDigit(*p)) return 0;
+        while (p < end && isDigit(*p)) p++;
+    }
+    return p == end;
+}
+
+// ---------------------------------------------------------------------------
+// Powers of five for the Eisel-Lemire algorithm: the 128 most significant
+// bits of 5^q, truncated for q >= 0 and rounded up for q < 0 (as in
+// fast_float). They are computed with a small bignum on first use instead
+// of being shipped as a 10 KB table.
+
+typedef struct {
+    uint32_t limb[28];      // Little endian; 5^342 needs 795 bits
+    int count;
+} Big;
+
+static uint64_t pow5[POW5_MAX - POW5_MIN + 1][2];  // {high, low}
+static pthread_once_t pow5Once = PTHREAD_ONCE_INIT;
+
+static void bigMul5(Big* a) {
+    uint64_t carry = 0;
+    for (int i = 0; i < a->count; i++) {
+        uint64_t x = (uint64_t)a->limb[i] * 5 + carry;
+        a->limb[i] = (uint32_t)x;
+        carry = x >> 32;
+    }
+    if (carry) a->limb[a->count++] = (uint32_t)carry;
+}
+
+static int bigBits(const Big* a) {
+    return (a->count - 1) * 32 + 32 - __builtin_clz(a->limb[a->count - 1]);
+}
+
+static int bigBit(const Big* a, int bit) {
+    if (bit < 0 || bit >= a->count * 32) return 0;
+    return (a->limb[bit >> 5] >> (bit & 31)) & 1;
+}
+
+static int bigLess(const Big* a, const Big* b) {
+    if (a->count != b->count) return a->count < b->count;
+    for (int i = a->count - 1; i >= 0; i--) {
+        if (a->limb[i] != b->limb[i]) return a->limb[i] < b->limb[i];
+    }
+    return 0;
+}
+
+// a -= b, for a >= b.
+static void bigSub(Big* a, const Big* b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < a->count; i++) {
+        int64_t x = (int64_t)a->limb[i] - (i < b->count ? b->limb[i] : 0) - borrow;
+        borrow = x < 0;
+        a->limb[i] = (uint32_t)(x + (borrow << 32));
+    }
+    while (a->count > 1 && a->limb[a->count - 1] == 0) a->count--;
+}
+
+static void bigShiftLeft1(Big* a) {
+    uint32_t carry = 0;
+    for (int i = 0; i < a->count; i++) {
+        uint32_t next = a->limb[i] >> 31;
+        a->limb[i] = (a->limb[i] << 1) | carry;
+        carry = next;
+    }
+    if (carry) a->limb[a->count++] = carry;
+}
+
+// Top 128 bits of 5^q for q >= 0.
+static unsigned __int128 truncatedPower(const Big* p) {
+    int top = bigBits(p) - 1;
+    unsigned __int128 x = 0;
+    for (int bit = top; bit > top - 128; bit--) {
+        x = (x << 1) | (unsigned __int128)bigBit(p, bit);
+    }
+    return x;
+}
+
+// floor(2^b / 5^k) + 1, cut to its top 128 bits, where b makes the
+// quotient at least 128 bits long. Long division by bits: the quotient
+// starts at bit b - z with remainder 2^z - 5^k, and only its top 128 bits
+// and whether all lower ones are set matter.
+static unsigned __int128 reciprocalPower(const Big* p, int k) {
+    int z = bigBits(p);
+    int b = k <= 27 ? z + 127 : 2 * z + 128;
+    Big r;
+    memset(&r, 0, sizeof(r));
+    r.count = z / 32 + 1;
+    r.limb[z / 32] = 1u << (z % 32);
+    bigSub(&r, p);
+
+    unsigned __int128 x = 1;
+    int left = b - z;       // Quotient bits still to produce
+    for (int i = 0; i < 127; i++, left--) {
+        bigShiftLeft1(&r);
+        int bit = !bigLess(&r, p);
+        if (bit) bigSub(&r, p);
+        x = (x << 1) | (unsigned __int128)bit;
+    }
+    int allOnes = 1;
+    for (; allOnes && left > 0; left--) {
+        bigShiftLeft1(&r);
+        allOnes = !bigLess(&r, p);
+        if (allOnes) bigSub(&r, p);
+    }
+    if (!allOnes) return x;
+    if (++x == 0) x = (unsigned __int128)1 << 127;
+    return x;
+}
+
+static void storePower(int q, unsigned __int128 x) {
+    pow5[q - POW5_MIN][0] = (uint64_t)(x >> 64);
+    pow5[q - POW5_MIN][1] = (uint64_t)x;
+}
+
+static void initPowers(void) {
+    Big p;
+    memset(&p, 0, sizeof(p));
+    p.limb[0] = 1;
+    p.count = 1;
+    storePower(0, (unsigned __int128)1 << 127);
+    for (int k = 1; k <= -POW5_MIN; k++) {
+        bigMul5(&p);
+        if (k <= POW5_MAX) storePower(k, truncatedPower(&p));
+        storePower(-k, reciprocalPower(&p, k));
+    }
+}
+
+// Bits of the double nearest to w * 10^q, for w != 0 and q within the
+// table. This is fast_float's variant, which needs no fallback for
+// mantissas that are exact.
+static uint64_t eiselLemire(uint64_t w, int q) {
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    const uint64_t* power = pow5[q - POW5_MIN];
+    unsigned __int128 product = (unsigned __int128)w * power[0];
+    uint64_t hi = (uint64_t)(product >> 64);
+    uint64_t lo = (uint64_t)product;
+    if ((hi & 0x1FF) == 0x1FF) {
+        // Too close to a rounding boundary; take the low half of the power in
+        uint64_t more = (uint64_t)(((unsigned __int128)w * power[1]) >> 64);
+        lo += more;
+        if (more > lo) hi++;
+    }
+
+    int upperBit = (int)(hi >> 63);
+    int shift = upperBit + 9;
+    uint64_t mantissa = hi >> shift;
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upperBit - lz + 1023;
+
+    if (power2 <= 0) {
+        // Subnormal, unless rounding carries it into the smallest normal
+        if (-power2 + 1 >= 64) return 0;
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < (1ULL << 52) ? 0 : 1;
+        return ((uint64_t)power2 << 52) | mantissa;
+    }
+
+    // Exactly halfway between two doubles: round to even. Only small
+    // powers of ten can produce an exact product.
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi) {
+        mantissa &= ~1ULL;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << 52)) {
+        mantissa = 1ULL << 52;
+        power2++;
+    }
+    mantissa &= ~(1ULL << 52);
+    if (power2 >= 0x7FF) return 0x7FFULL << 52;
+    return ((uint64_t)power2 << 52) | mantissa;
+}
+
+static double slowToDouble(const char* p, size_t n) {
+    char stack[64];
+    char* text = n < sizeof(stack) ? stack : malloc(n + 1);
+    if (!text) return 0;
+    memcpy(text, p, n);
+    text[n] = '\0';
+    double d = strtod(text, NULL);
+    if (text != stack) free(text);
+    return d;
+}
+
+static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Correctly rounded. Up to 19 significant digits go into a 64-bit
+// mantissa; when both it and the power of ten are exact doubles, one IEEE
+// multiplication or division is exact (Clinger). Otherwise Eisel-Lemire
+// multiplies by a 128-bit power of five. Longer mantissas are cut to 19
+// digits and checked by rounding both ends of the cut; strtod() settles
+// the rare cases where those differ.
+double numberToDouble(const char* p, size_t n) {
+    const char* end = p + n;
+    int negative = p < end && *p == '-';
+    if (negative) p++;
+
+    uint64_t w = 0;
+    int digits = 0;
+    int64_t exp10 = 0;
+    int truncated = 0;
+    for (; p < end && isDigit(*p); p++) {
+        int d = *p - '0';
+        if (digits < 19) {
+            if (w || d) {
+                w = w * 10 + (uint64_t)d;
+                digits++;
+            }
+        } else {
+            exp10++;
+            truncated |= d;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            int d = *p - '0';
+            if (digits < 19) {
+                if (w || d) {
+                    w = w * 10 + (uint64_t)d;
+                    digits++;
+                }
+                exp10--;
+            } else {
+                truncated |= d;
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int expNegative = p < end && *p == '-';
+        if (p < end && (*p == '+' || *p == '-')) p++;
+        int64_t e = 0;
+        for (; p < end && isDigit(*p); p++) {
+            if (e < 100000) e = e * 10 + (*p - '0');
+        }
+        exp10 += expNegative ? -e : e;
+    }
+
+    double d;
+    if (w == 0 || exp10 < POW5_MIN) {
+        d = 0;
+    } else if (exp10 > POW5_MAX) {
+        d = __builtin_inf();
+    } else if (!truncated && w <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        d = (double)w;
+        d = exp10 < 0 ? d / powersOfTen[-exp10] : d * powersOfTen[exp10];
+    } else {
+        pthread_once(&pow5Once, initPowers);
+        uint64_t bits = eiselLemire(w, (int)exp10);
+        if (truncated && eiselLemire(w + 1, (int)exp10) != bits) {
+            return slowToDouble(end - n, n);
+        }
+        memcpy(&d, &bits, sizeof(d));
+    }
+    return negative ? -d : d;
+}
+
+Number numberParse(const char* p, size_t n) {
+    Number num;
+    const char* s = p + (*p == '-');
+    const char* end = p + n;
+    uint64_t u = 0;
+    int overflow = 0;
+    for (; s < end && isDigit(*s); s++) {
+        overflow |= __builtin_mul_overflow(u, 10, &u);
+        overflow |= __builtin_add_overflow(u, (uint64_t)(*s - '0'), &u);
+    }
+    if (s < end || overflow || (*p == '-' && u > (1ULL << 63))) {
+        num.kind = NUMBER_DOUBLE;
+        num.as.d = numberToDouble(p, n);
+    } else if (*p == '-') {
+        num.kind = NUMBER_INT;
+        num.as.i = (int64_t)(0 - u);
+    } else if (u <= INT64_MAX) {
+        num.kind = NUMBER_INT;
+        num.as.i = (int64_t)u;
+    } else {
+        num.kind = NUMBER_UINT;
+        num.as.u = u;
+    }
+    return num;
+}
+
+// The fewest %g digits that read back as d. A rounding to more digits is
+// never further from d, so the count can be found by bisection.
+size_t numberFormat(double d, char* buf, size_t cap) {
+    int lo = 1, hi = 17;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        snprintf(buf, cap, "%.*g", mid, d);
+        if (strtod(buf, NULL) == d) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    // %g picks an exponent once it reaches the precision; write 100, not 1e+02
+    snprintf(buf, cap, "%.*e", lo - 1, d);
+    const char* e = strchr(buf, 'e');
+    int exponent = e ? atoi(e + 1) : 0;
+    if (exponent >= lo && exponent < 17) lo = exponent + 1;
+    return (size_t)snprintf(buf, cap, "%.*g", lo, d);
+}
@@ -0,0 +1,37 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// JSON numbers are kept as their input text (VALUE_NUMBER) and written to
+// CSV as they are. These functions turn that text into a binary value for
+// consumers that need one.
+
+typedef enum {
+    NUMBER_INT,         // Integer that fits int64_t
+    NUMBER_UINT,        // Integer above INT64_MAX that fits uint64_t
+    NUMBER_DOUBLE       // Fraction or exponent, or an integer out of range
+} NumberKind;
+
+typedef struct {
+    NumberKind kind;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    } as;
+} Number;
+
+// Returns 1 if p[0..n) is a number as RFC 8259 defines it:
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+int numberValid(const char* p, size_t n);
+
+// p[0..n) must be valid.
+Number numberParse(const char* p, size_t n);
+double numberToDouble(const char* p, size_t n);
+
+// Writes the shortest text that reads back as d. Returns its length.
+size_t numberFormat(double d, char* buf, size_t cap);
+
+#endif
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "output.h"
+#include "log.h"
+
+// Opens path for writing behind a buffer of bufSize bytes. Nothing is
+// written until the buffer fills or the file is closed.
+int outputOpen(OutputBuffer* out, const char* path, size_t bufSize) {
+    memset(out, 0, sizeof(*out));
+    out->path = path;
+    out->cap = bufSize ? bufSize : OUTPUT_DEFAULT_BUFFER_SIZE;
+    out->buf = malloc(out->cap);
+    if (!out->buf) {
+        logError("Memory allocation failed for output buffer of %s", path);
+        return 0;
+    }
+    out->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out->fd < 0) {
+        logError("Could not open file %s for writing: %s", path, strerror(errno));
+        free(out->buf);
+        out->buf = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+static int writeAll(OutputBuffer* out, const char* p, size_t n) {
+    if (out->failed) return 0;
+    while (n > 0) {
+        ssize_t w = write(out->fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            logError("Failed to write to %s: %s", out->path, strerror(errno));
+            out->failed = 1;
+            return 0;
+        }
+        p += w;
+        n -= (size_t)w;
+        out->written += (size_t)w;
+    }
+    return 1;
+}
+
+// Writes out everything pending. Returns 0 once any write has failed.
+int outputFlush(OutputBuffer* out) {
+    int ok = writeAll(out, out->buf, out->len);
+    out->len = 0;
+    return ok;
+}
+
+// Flushes and closes the file, reporting any error that was not
+// reported yet. Returns 0 if the file is incomplete.
+int outputClose(OutputBuffer* out) {
+    int ok = outputFlush(out);
+    if (close(out->fd) != 0 && ok) {
+        logError("Failed to close %s: %s", out->path, strerror(errno));
+        ok = 0;
+    }
+    free(out->buf);
+    out->buf = NULL;
+    return ok;
+}
+
+void outputBytes(OutputBuffer* out, const char* p, size_t n) {
+    char* dst = outputReserve(out, n);
+    if (dst) {
+        memcpy(dst, p, n);
+        out->len += n;
+    } else if (outputFlush(out)) {
+        // Too big for the buffer: hand it to the kernel directly.
+        writeAll(out, p, n);
+    }
+}
+
+static const char digitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Formats two digits at a time from the right, without going through
+// printf.
+void outputInt(OutputBuffer* out, int64_t value) {
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    while (v >= 100) {
+        unsigned pair = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = digitPairs[pair + 1];
+        *--p = digitPairs[pair];
+    }
+    if (v >= 10) {
+        *--p = digitPairs[v * 2 + 1];
+        *--p = digitPairs[v * 2];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    if (value < 0) *--p = '-';
+    outputBytes(out, p, (size_t)(tmp + sizeof(tmp) - p));
+}
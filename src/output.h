@@ -0,0 +1,44 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define OUTPUT_DEFAULT_BUFFER_SIZE (4 << 20)
+
+typedef struct {
+    int fd;             // Destination file
+    char* buf;          // Pending bytes, written out when full
+    size_t len;         // Bytes pending in buf
+    size_t cap;         // Size of buf
+    const char* path;   // For error messages
+    int failed;         // Set by the first failed write; later output is dropped
+    size_t written;     // Bytes written to the file so far
+} OutputBuffer;
+
+int outputOpen(OutputBuffer* out, const char* path, size_t bufSize);
+int outputFlush(OutputBuffer* out);
+int outputClose(OutputBuffer* out);
+void outputBytes(OutputBuffer* out, const char* p, size_t n);
+void outputInt(OutputBuffer* out, int64_t value);
+
+// Returns room for n more bytes in the buffer, flushing it first if
+// needed, or NULL if n is larger than the whole buffer.
+static inline char* outputReserve(OutputBuffer* out, size_t n) {
+    if (out->cap - out->len < n) {
+        if (n > out->cap || !outputFlush(out)) return NULL;
+    }
+    return out->buf + out->len;
+}
+
+static inline void outputByte(OutputBuffer* out, char c) {
+    if (out->len == out->cap && !outputFlush(out)) return;
+    out->buf[out->len++] = c;
+}
+
+static inline void outputStr(OutputBuffer* out, const char* s) {
+    outputBytes(out, s, strlen(s));
+}
+
+#endif
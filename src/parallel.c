@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "parallel.h"
+
+int parallelJobs = 0;
+
+typedef struct {
+    ParallelFn fn;
+    void* ctx;
+    int count;
+    int next;           // Next index to hand out, taken atomically
+} ParallelWork;
+
+static void* worker(void* arg) {
+    ParallelWork* work = arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED);
+        if (i >= work->count) break;
+        work->fn(work->ctx, i);
+    }
+    return NULL;
+}
+
+static int cpuCount;     // Online CPUs, looked up on first use
+
+// Resolves --jobs: an explicit count, or the number of online CPUs.
+int parallelJobCount(void) {
+    if (parallelJobs > 0) return parallelJobs;
+    int cpus = __atomic_load_n(&cpuCount, __ATOMIC_RELAXED);
+    if (!cpus) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        cpus = online > 0 ? (int)online : 1;
+        __atomic_store_n(&cpuCount, cpus, __ATOMIC_RELAXED);
+    }
+    return cpus;
+}
+
+void parallelFor(int count, int jobs, ParallelFn fn, void* ctx) {
+    ParallelWork work = { fn, ctx, count, 0 };
+    if (jobs > count) jobs = count;
+    if (jobs <= 1) {
+        worker(&work);
+        return;
+    }
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * (jobs - 1));
+    int started = 0;
+    if (threads) {
+        while (started < jobs - 1 && pthread_create(&threads[started], NULL, worker, &work) == 0) {
+            started++;
+        }
+    }
+    worker(&work);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
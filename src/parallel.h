@@ -0,0 +1,15 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Runs fn(ctx, i) for every i in [0, count) on up to jobs threads (the
+// calling thread included). Items are handed out in index order, so
+// callers put the most expensive ones first. If threads cannot be
+// started, the calling thread does the remaining work itself.
+typedef void (*ParallelFn)(void* ctx, int index);
+
+extern int parallelJobs;    // Thread count from --jobs; 0 means one per CPU
+
+int parallelJobCount(void);
+void parallelFor(int count, int jobs, ParallelFn fn, void* ctx);
+
+#endif
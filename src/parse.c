@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+#include "parse.h"
+#include "stats.h"
+
+// The flex scanner, in scanner.l
+extern void* flexOpen(const char* buf, size_t len);
+extern int flexNext(void* scanner, YYSTYPE* lval);
+extern void flexPosition(void* scanner, int* line, int* col);
+extern void flexClose(void* scanner);
+
+void parseInit(ParseContext* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    arenaInit(&ctx->arena, ARENA_DEFAULT_BLOCK_SIZE);
+}
+
+// Parses buf into ctx->root with the lexer --lexer picks. Returns the
+// yyparse() result, 0 on success. The AST stays valid until
+// parseReset() or parseFree(), and its strings point into buf. The simd
+// lexer interns object keys into keys (the keys of the SymbolTable the AST
+// will be walked into) and pairs carry their id; pass NULL to leave that
+// to walkAST(). jobs is passed on to lexerInit().
+static void closeLexers(ParseContext* ctx) {
+    lexerFree(&ctx->lexer);
+    if (ctx->flex) flexClose(ctx->flex);
+    ctx->flex = NULL;
+}
+
+int parseDocument(ParseContext* ctx, const char* buf, size_t len, Interner* keys, int jobs) {
+    closeLexers(ctx);
+    ctx->root = NULL;
+    if (lexerMode == LEXER_FLEX) {
+        ctx->flex = flexOpen(buf, len);
+        if (!ctx->flex) return 1;
+    } else {
+        statsStart(STATS_LEX);
+        int ok = lexerInit(&ctx->lexer, buf, len, jobs);
+        statsStop(STATS_LEX);
+        if (!ok) return 1;
+        ctx->lexer.keys = keys;
+        if (statsEnabled) j2r_stats.tokens += lexerTokenCount(&ctx->lexer);
+    }
+    // The flex lexer runs inside yyparse(), so its time counts as parsing
+    statsStart(STATS_PARSE);
+    int result = yyparse(ctx);
+    statsStop(STATS_PARSE);
+    return result;
+}
+
+void parsePosition(const ParseContext* ctx, int* outLine, int* outCol) {
+    if (lexerMode == LEXER_FLEX) {
+        flexPosition(ctx->flex, outLine, outCol);
+        return;
+    }
+    lexerPosition(&ctx->lexer, ctx->lexer.tokEnd, outLine, outCol);
+}
+
+int yylex(YYSTYPE* lval, ParseContext* ctx) {
+    if (lexerMode == LEXER_FLEX) {
+        int tok = flexNext(ctx->flex, lval);
+        if (statsEnabled && tok) j2r_stats.tokens++;
+        return tok;
+    }
+    return lexerNext(&ctx->lexer, lval);
+}
+
+// Drops the document but keeps a block of the arena for the next one.
+void parseReset(ParseContext* ctx) {
+    closeLexers(ctx);
+    arenaReset(&ctx->arena);
+    ctx->root = NULL;
+}
+
+void parseFree(ParseContext* ctx) {
+    closeLexers(ctx);
+    arenaFree(&ctx->arena);
+    ctx->root = NULL;
+}
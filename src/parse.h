@@ -0,0 +1,24 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "ast.h"
+#include "lexer.h"
+
+// Everything one yyparse() call works on, so that several documents can
+// be parsed at once on different threads, with either lexer.
+struct ParseContext {
+    Lexer lexer;        // Structural index of the input (simd lexer)
+    void* flex;         // Scanner of the input (flex lexer), or NULL
+    Arena arena;        // Holds every AST node of the document
+    ASTNode* root;      // Document root, set when the parse succeeds
+};
+
+void parseInit(ParseContext* ctx);
+int parseDocument(ParseContext* ctx, const char* buf, size_t len, Interner* keys, int jobs);
+void parsePosition(const ParseContext* ctx, int* line, int* col);
+void parseReset(ParseContext* ctx);
+void parseFree(ParseContext* ctx);
+
+#endif
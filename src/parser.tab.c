@@ -55,7 +55,7 @@
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 0
+#define YYPURE 2
 
 /* Push parsers.  */
 #define YYPUSH 0
@@ -72,22 +72,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ast.h"  
-#include "symbol_table.h"
+#include "log.h"
 
-extern int yylex();
-extern int yylineno;
-extern int col;
-
-void yyerror(const char *s);
-
-ASTNode* createNode(const char* type);
-ASTNode* createStrNode(const char* type, char* val);
-ASTNode* createIntNode(const char* type, int val);
-ASTNode* createBoolNode(const char* type, int val);
-
-ASTNode* rootNode = NULL;
-
-#line 91 "parser.tab.c"
+#line 78 "parser.tab.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -142,6 +129,12 @@ typedef enum yysymbol_kind_t yysymbol_kind_t;
 
 
 
+/* Unqualified %code blocks.  */
+#line 29 "parser.y"
+
+#include "parse.h"
+
+#line 138 "parser.tab.c"
 
 #ifdef short
 # undef short
@@ -523,8 +516,8 @@ static const yytype_int8 yytranslate[] =
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_int8 yyrline[] =
 {
-       0,    41,    41,    48,    49,    50,    51,    52,    53,    54,
-      58,    62,    68,    69,    73,    80,    83,    93,    97
+       0,    56,    56,    63,    64,    65,    66,    67,    68,    69,
+      73,    77,    83,    84,    88,    96,    99,   106,   110
 };
 #endif
 
@@ -660,7 +653,7 @@ enum { YYENOMEM = -2 };
       }                                                           \
     else                                                          \
       {                                                           \
-        yyerror (YY_("syntax error: cannot back up")); \
+        yyerror (ctx, YY_("syntax error: cannot back up")); \
         YYERROR;                                                  \
       }                                                           \
   while (0)
@@ -693,7 +686,7 @@ do {                                                                      \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Kind, Value); \
+                  Kind, Value, ctx); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
@@ -705,10 +698,11 @@ do {                                                                      \
 
 static void
 yy_symbol_value_print (FILE *yyo,
-                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, ParseContext* ctx)
 {
   FILE *yyoutput = yyo;
   YY_USE (yyoutput);
+  YY_USE (ctx);
   if (!yyvaluep)
     return;
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
@@ -723,12 +717,12 @@ yy_symbol_value_print (FILE *yyo,
 
 static void
 yy_symbol_print (FILE *yyo,
-                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, ParseContext* ctx)
 {
   YYFPRINTF (yyo, "%s %s (",
              yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyo, yykind, yyvaluep);
+  yy_symbol_value_print (yyo, yykind, yyvaluep, ctx);
   YYFPRINTF (yyo, ")");
 }
 
@@ -762,7 +756,7 @@ do {                                                            \
 
 static void
 yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
-                 int yyrule)
+                 int yyrule, ParseContext* ctx)
 {
   int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
@@ -775,7 +769,7 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
                        YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
-                       &yyvsp[(yyi + 1) - (yynrhs)]);
+                       &yyvsp[(yyi + 1) - (yynrhs)], ctx);
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -783,7 +777,7 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
 # define YY_REDUCE_PRINT(Rule)          \
 do {                                    \
   if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, Rule); \
+    yy_reduce_print (yyssp, yyvsp, Rule, ctx); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
@@ -824,9 +818,10 @@ int yydebug;
 
 static void
 yydestruct (const char *yymsg,
-            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, ParseContext* ctx)
 {
   YY_USE (yyvaluep);
+  YY_USE (ctx);
   if (!yymsg)
     yymsg = "Deleting";
   YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
@@ -837,13 +832,6 @@ yydestruct (const char *yymsg,
 }
 
 
-/* Lookahead token kind.  */
-int yychar;
-
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-/* Number of syntax errors so far.  */
-int yynerrs;
 
 
 
@@ -853,8 +841,21 @@ int yynerrs;
 `----------*/
 
 int
-yyparse (void)
+yyparse (ParseContext* ctx)
 {
+/* Lookahead token kind.  */
+int yychar;
+
+
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
+
     yy_state_fast_t yystate = 0;
     /* Number of tokens to shift before error messages enabled.  */
     int yyerrstatus = 0;
@@ -1007,7 +1008,7 @@ yybackup:
   if (yychar == YYEMPTY)
     {
       YYDPRINTF ((stderr, "Reading a token\n"));
-      yychar = yylex ();
+      yychar = yylex (&yylval, ctx);
     }
 
   if (yychar <= YYEOF)
@@ -1095,134 +1096,132 @@ yyreduce:
   switch (yyn)
     {
   case 2: /* json: value  */
-#line 41 "parser.y"
+#line 56 "parser.y"
           {
-        printf("Debug: JSON parsed successfully, setting rootNode\n");
-        rootNode = (yyvsp[0].ast); 
+        logDebug("JSON parsed successfully, setting rootNode");
+        ctx->root = (yyvsp[0].ast); 
     }
-#line 1104 "parser.tab.c"
+#line 1105 "parser.tab.c"
     break;
 
   case 3: /* value: STRING  */
-#line 48 "parser.y"
-                    { (yyval.ast) = createStrNode("string", (yyvsp[0].strVal)); }
-#line 1110 "parser.tab.c"
+#line 63 "parser.y"
+                    { (yyval.ast) = createStrNode(&ctx->arena, NODE_STRING, (yyvsp[0].str).text); }
+#line 1111 "parser.tab.c"
     break;
 
   case 4: /* value: NUMBER  */
-#line 49 "parser.y"
-                    { (yyval.ast) = createIntNode("number", (yyvsp[0].intVal)); }
-#line 1116 "parser.tab.c"
+#line 64 "parser.y"
+                    { (yyval.ast) = createStrNode(&ctx->arena, NODE_NUMBER, (yyvsp[0].strVal)); }
+#line 1117 "parser.tab.c"
     break;
 
   case 5: /* value: TRUE  */
-#line 50 "parser.y"
-                    { (yyval.ast) = createBoolNode("bool", 1); (yyval.ast)->hasBool = 1; }
-#line 1122 "parser.tab.c"
+#line 65 "parser.y"
+                    { (yyval.ast) = createBoolNode(&ctx->arena, NODE_BOOL, 1); }
+#line 1123 "parser.tab.c"
     break;
 
   case 6: /* value: FALSE  */
-#line 51 "parser.y"
-                    { (yyval.ast) = createBoolNode("bool", 0); (yyval.ast)->hasBool = 1; }
-#line 1128 "parser.tab.c"
+#line 66 "parser.y"
+                    { (yyval.ast) = createBoolNode(&ctx->arena, NODE_BOOL, 0); }
+#line 1129 "parser.tab.c"
     break;
 
   case 7: /* value: NULLTOK  */
-#line 52 "parser.y"
-                    { (yyval.ast) = createNode("null"); }
-#line 1134 "parser.tab.c"
+#line 67 "parser.y"
+                    { (yyval.ast) = createNode(&ctx->arena, NODE_NULL); }
+#line 1135 "parser.tab.c"
     break;
 
   case 8: /* value: object  */
-#line 53 "parser.y"
+#line 68 "parser.y"
                     { (yyval.ast) = (yyvsp[0].ast); }
-#line 1140 "parser.tab.c"
+#line 1141 "parser.tab.c"
     break;
 
   case 9: /* value: array  */
-#line 54 "parser.y"
+#line 69 "parser.y"
                     { (yyval.ast) = (yyvsp[0].ast); }
-#line 1146 "parser.tab.c"
+#line 1147 "parser.tab.c"
     break;
 
   case 10: /* object: LEFT_BRACE members RIGHT_BRACE  */
-#line 58 "parser.y"
+#line 73 "parser.y"
                                    { 
-        (yyval.ast) = createNode("object"); 
-        addChild((yyval.ast), (yyvsp[-1].ast)); 
+        (yyval.ast) = createNode(&ctx->arena, NODE_OBJECT); 
+        addChild(&ctx->arena, (yyval.ast), (yyvsp[-1].ast)); 
     }
-#line 1155 "parser.tab.c"
+#line 1156 "parser.tab.c"
     break;
 
   case 11: /* object: LEFT_BRACE RIGHT_BRACE  */
-#line 62 "parser.y"
+#line 77 "parser.y"
                                    { 
-        (yyval.ast) = createNode("empty_object"); 
+        (yyval.ast) = createNode(&ctx->arena, NODE_EMPTY_OBJECT); 
     }
-#line 1163 "parser.tab.c"
+#line 1164 "parser.tab.c"
     break;
 
   case 12: /* members: pair  */
-#line 68 "parser.y"
-                        { (yyval.ast) = createNode("members"); addChild((yyval.ast), (yyvsp[0].ast)); }
-#line 1169 "parser.tab.c"
+#line 83 "parser.y"
+                        { (yyval.ast) = createNode(&ctx->arena, NODE_MEMBERS); addChild(&ctx->arena, (yyval.ast), (yyvsp[0].ast)); }
+#line 1170 "parser.tab.c"
     break;
 
   case 13: /* members: members COMMA pair  */
-#line 69 "parser.y"
-                        { (yyval.ast) = (yyvsp[-2].ast); addChild((yyval.ast), (yyvsp[0].ast)); }
-#line 1175 "parser.tab.c"
+#line 84 "parser.y"
+                        { (yyval.ast) = (yyvsp[-2].ast); addChild(&ctx->arena, (yyval.ast), (yyvsp[0].ast)); }
+#line 1176 "parser.tab.c"
     break;
 
   case 14: /* pair: STRING COLON value  */
-#line 73 "parser.y"
+#line 88 "parser.y"
                        {
-        (yyval.ast) = createStrNode("pair", (yyvsp[-2].strVal));
-        addChild((yyval.ast), (yyvsp[0].ast));
+        (yyval.ast) = createStrNode(&ctx->arena, NODE_PAIR, (yyvsp[-2].str).text);
+        (yyval.ast)->keyId = (yyvsp[-2].str).keyId;
+        addChild(&ctx->arena, (yyval.ast), (yyvsp[0].ast));
     }
-#line 1184 "parser.tab.c"
+#line 1186 "parser.tab.c"
     break;
 
   case 15: /* array: LEFT_BRACKET RIGHT_BRACKET  */
-#line 80 "parser.y"
+#line 96 "parser.y"
                                {
-        (yyval.ast) = createNode("array");
+        (yyval.ast) = createNode(&ctx->arena, NODE_ARRAY);
     }
-#line 1192 "parser.tab.c"
+#line 1194 "parser.tab.c"
     break;
 
   case 16: /* array: LEFT_BRACKET elements RIGHT_BRACKET  */
-#line 83 "parser.y"
+#line 99 "parser.y"
                                           {
-        (yyval.ast) = createNode("array");
-        for (int i = 0; i < (yyvsp[-1].ast)->childCount; i++) {
-            addChild((yyval.ast), (yyvsp[-1].ast)->children[i]);
-        }
-        free((yyvsp[-1].ast));
+        (yyval.ast) = (yyvsp[-1].ast);
+        (yyval.ast)->kind = NODE_ARRAY;
     }
-#line 1204 "parser.tab.c"
+#line 1203 "parser.tab.c"
     break;
 
   case 17: /* elements: value  */
-#line 93 "parser.y"
+#line 106 "parser.y"
           {
-        (yyval.ast) = createNode("elements");
-        addChild((yyval.ast), (yyvsp[0].ast));
+        (yyval.ast) = createNode(&ctx->arena, NODE_ELEMENTS);
+        addChild(&ctx->arena, (yyval.ast), (yyvsp[0].ast));
     }
-#line 1213 "parser.tab.c"
+#line 1212 "parser.tab.c"
     break;
 
   case 18: /* elements: elements COMMA value  */
-#line 97 "parser.y"
+#line 110 "parser.y"
                            { 
-        addChild((yyvsp[-2].ast), (yyvsp[0].ast));
+        addChild(&ctx->arena, (yyvsp[-2].ast), (yyvsp[0].ast));
         (yyval.ast) = (yyvsp[-2].ast);
     }
-#line 1222 "parser.tab.c"
+#line 1221 "parser.tab.c"
     break;
 
 
-#line 1226 "parser.tab.c"
+#line 1225 "parser.tab.c"
 
       default: break;
     }
@@ -1269,7 +1268,7 @@ yyerrlab:
   if (!yyerrstatus)
     {
       ++yynerrs;
-      yyerror (YY_("syntax error"));
+      yyerror (ctx, YY_("syntax error"));
     }
 
   if (yyerrstatus == 3)
@@ -1286,7 +1285,7 @@ yyerrlab:
       else
         {
           yydestruct ("Error: discarding",
-                      yytoken, &yylval);
+                      yytoken, &yylval, ctx);
           yychar = YYEMPTY;
         }
     }
@@ -1342,7 +1341,7 @@ yyerrlab1:
 
 
       yydestruct ("Error: popping",
-                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, ctx);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -1380,7 +1379,7 @@ yyabortlab:
 | yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
 `-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror (YY_("memory exhausted"));
+  yyerror (ctx, YY_("memory exhausted"));
   yyresult = 2;
   goto yyreturnlab;
 
@@ -1395,7 +1394,7 @@ yyreturnlab:
          user semantic actions for why this is necessary.  */
       yytoken = YYTRANSLATE (yychar);
       yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval);
+                  yytoken, &yylval, ctx);
     }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
@@ -1404,7 +1403,7 @@ yyreturnlab:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, ctx);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
@@ -1415,9 +1414,11 @@ yyreturnlab:
   return yyresult;
 }
 
-#line 103 "parser.y"
+#line 116 "parser.y"
 
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Parse error at line %d, col %d: %s\n", yylineno, col, s);
+void yyerror(ParseContext* ctx, const char *s) {
+    int line, col;
+    parsePosition(ctx, &line, &col);
+    logError("Parse error at line %d, col %d: %s", line, col, s);
 }
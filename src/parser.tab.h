@@ -44,6 +44,24 @@
 #if YYDEBUG
 extern int yydebug;
 #endif
+/* "%code requires" blocks.  */
+#line 8 "parser.y"
+
+#include "slice.h"
+typedef struct ParseContext ParseContext;
+
+// Library users may have parsers of their own
+#define yyparse j2r_yyparse
+#define yylex j2r_yylex
+#define yyerror j2r_yyerror
+
+// keyId is the id of an object key the lexer interned, -1 otherwise
+typedef struct {
+    Slice text;
+    int keyId;
+} StringToken;
+
+#line 65 "parser.tab.h"
 
 /* Token kinds.  */
 #ifndef YYTOKENTYPE
@@ -73,14 +91,14 @@ extern int yydebug;
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
 union YYSTYPE
 {
-#line 21 "parser.y"
+#line 36 "parser.y"
 
-    char* strVal;
-    int intVal;
+    Slice strVal;
+    StringToken str;
     int boolVal;
     struct ASTNode* ast;  
 
-#line 84 "parser.tab.h"
+#line 102 "parser.tab.h"
 
 };
 typedef union YYSTYPE YYSTYPE;
@@ -89,10 +107,16 @@ typedef union YYSTYPE YYSTYPE;
 #endif
 
 
-extern YYSTYPE yylval;
 
 
-int yyparse (void);
+int yyparse (ParseContext* ctx);
+
+/* "%code provides" blocks.  */
+#line 24 "parser.y"
+
+int yylex(YYSTYPE* lval, ParseContext* ctx);
+void yyerror(ParseContext* ctx, const char *s);
 
+#line 121 "parser.tab.h"
 
 #endif /* !YY_YY_PARSER_TAB_H_INCLUDED  */
@@ -2,31 +2,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ast.h"  
-#include "symbol_table.h"
+#include "log.h"
+%}
 
-extern int yylex();
-extern int yylineno;
-extern int col;
+%code requires {
+#include "slice.h"
+typedef struct ParseContext ParseContext;
 
-void yyerror(const char *s);
+// Library users may have parsers of their own
+#define yyparse j2r_yyparse
+#define yylex j2r_yylex
+#define yyerror j2r_yyerror
 
-ASTNode* createNode(const char* type);
-ASTNode* createStrNode(const char* type, char* val);
-ASTNode* createIntNode(const char* type, int val);
-ASTNode* createBoolNode(const char* type, int val);
+// keyId is the id of an object key the lexer interned, -1 otherwise
+typedef struct {
+    Slice text;
+    int keyId;
+} StringToken;
+}
 
-ASTNode* rootNode = NULL;
-%}
+%code provides {
+int yylex(YYSTYPE* lval, ParseContext* ctx);
+void yyerror(ParseContext* ctx, const char *s);
+}
+
+%code {
+#include "parse.h"
+}
+
+%define api.pure full
+%param {ParseContext* ctx}
 
 %union {
-    char* strVal;
-    int intVal;
+    Slice strVal;
+    StringToken str;
     int boolVal;
     struct ASTNode* ast;  
 }
 
-%token <strVal> STRING
-%token <intVal> NUMBER
+%token <str> STRING
+%token <strVal> NUMBER
 %token <boolVal> TRUE FALSE
 %token NULLTOK
 %token LEFT_BRACE RIGHT_BRACE LEFT_BRACKET RIGHT_BRACKET COLON COMMA
@@ -39,69 +54,69 @@ ASTNode* rootNode = NULL;
 
 json:
     value {
-        printf("Debug: JSON parsed successfully, setting rootNode\n");
-        rootNode = $1; 
+        logDebug("JSON parsed successfully, setting rootNode");
+        ctx->root = $1; 
     }
 ;
 
 value:
-      STRING        { $$ = createStrNode("string", $1); }
-    | NUMBER        { $$ = createIntNode("number", $1); }
-    | TRUE          { $$ = createBoolNode("bool", 1); $$->hasBool = 1; }
-    | FALSE         { $$ = createBoolNode("bool", 0); $$->hasBool = 1; }
-    | NULLTOK       { $$ = createNode("null"); }
+      STRING        { $$ = createStrNode(&ctx->arena, NODE_STRING, $1.text); }
+    | NUMBER        { $$ = createStrNode(&ctx->arena, NODE_NUMBER, $1); }
+    | TRUE          { $$ = createBoolNode(&ctx->arena, NODE_BOOL, 1); }
+    | FALSE         { $$ = createBoolNode(&ctx->arena, NODE_BOOL, 0); }
+    | NULLTOK       { $$ = createNode(&ctx->arena, NODE_NULL); }
     | object        { $$ = $1; }
     | array         { $$ = $1; }
 ;
 
 object:
     LEFT_BRACE members RIGHT_BRACE { 
-        $$ = createNode("object"); 
-        addChild($$, $2); 
+        $$ = createNode(&ctx->arena, NODE_OBJECT); 
+        addChild(&ctx->arena, $$, $2); 
     }
   | LEFT_BRACE RIGHT_BRACE         { 
-        $$ = createNode("empty_object"); 
+        $$ = createNode(&ctx->arena, NODE_EMPTY_OBJECT); 
     }
 ;
 
 members: 
-    pair                { $$ = createNode("members"); addChild($$, $1); }
-  | members COMMA pair  { $$ = $1; addChild($$, $3); }
+    pair                { $$ = createNode(&ctx->arena, NODE_MEMBERS); addChild(&ctx->arena, $$, $1); }
+  | members COMMA pair  { $$ = $1; addChild(&ctx->arena, $$, $3); }
 ;
 
 pair: 
     STRING COLON value {
-        $$ = createStrNode("pair", $1);
-        addChild($$, $3);
+        $$ = createStrNode(&ctx->arena, NODE_PAIR, $1.text);
+        $$->keyId = $1.keyId;
+        addChild(&ctx->arena, $$, $3);
     }
 ;
 
 array:
     LEFT_BRACKET RIGHT_BRACKET {
-        $$ = createNode("array");
+        $$ = createNode(&ctx->arena, NODE_ARRAY);
     }
     | LEFT_BRACKET elements RIGHT_BRACKET {
-        $$ = createNode("array");
-        for (int i = 0; i < $2->childCount; i++) {
-            addChild($$, $2->children[i]);
-        }
-        free($2);
+        $$ = $2;
+        $$->kind = NODE_ARRAY;
     }
 ;
 
 elements:
     value {
-        $$ = createNode("elements");
-        addChild($$, $1);
+        $$ = createNode(&ctx->arena, NODE_ELEMENTS);
+        addChild(&ctx->arena, $$, $1);
     }
     | elements COMMA value { 
-        addChild($1, $3);
+        addChild(&ctx->arena, $1, $3);
         $$ = $1;
     }
 ;
 
 %%
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Parse error at line %d, col %d: %s\n", yylineno, col, s);
+void yyerror(ParseContext* ctx, const char *s) {
+    int line, col;
+    parsePosition(ctx, &line, &col);
+    logError("Parse error at line %d, col %d: %s", line, col, s);
 }
\ No newline at end of file
@@ -0,0 +1,547 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "csv-writer.h"
+#include "input.h"
+#include "log.h"
+#include "parallel.h"
+#include "parse.h"
+#include "stream.h"
+#include "symbol_table.h"
+
+#define SERVER_BACKLOG 128
+#define SERVER_MAX_PAYLOAD ((size_t)1 << 30)
+#define SERVER_MAX_LINE (64 * 1024)
+#define SERVER_READ_SIZE 4096
+
+// One client connection. The poller reads requests into buf without
+// blocking and passes the connection to a worker only once a whole request
+// is buffered; the worker leaves its answer in reply for the poller to send.
+typedef struct Connection {
+    int fd;
+    char* buf;
+    size_t pos;         // First unread byte of buf
+    size_t len;         // Bytes read into buf
+    size_t cap;
+    size_t request;     // Length of the complete request at pos, 0 if none
+    char* reply;        // Answer still to be sent, or NULL
+    size_t replyLen;
+    size_t replySent;
+    int closing;        // Close once the reply is sent
+    int eof;            // The client will send nothing more
+    struct Connection* next;
+} Connection;
+
+// Workers answer one request at a time from whichever connection has one
+// buffered; the poller (the calling thread) does all socket I/O, so slow
+// and idle clients do not hold a worker.
+typedef struct {
+    int listenFd;
+    int stream;         // Convert with the streaming builder
+    int wakeFds[2];     // Written to when a connection is handed back
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Connection* readyHead;  // Connections with a request buffered
+    Connection* readyTail;
+    Connection* done;       // Answered since the poller last looked
+    int stopping;
+} Server;
+
+// Each worker thread keeps its parse arena between requests, so small
+// requests stop allocating once the worker is warm.
+typedef struct {
+    ParseContext parse;
+} Worker;
+
+static const char* socketPath;
+
+static void onSignal(int sig) {
+    unlink(socketPath);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Answers a failed request with the first error logged while handling it.
+// Messages may quote input, so line breaks are flattened.
+static void replyError(FILE* out, const char* error, const char* fallback) {
+    fputs("ERROR ", out);
+    for (const char* p = error[0] ? error : fallback; *p; p++) {
+        fputc(*p == '\n' || *p == '\r' ? ' ' : *p, out);
+    }
+    fputc('\n', out);
+}
+
+// Writes a table name taken from the input so that it stays one field of
+// one line: control bytes, spaces, '%' and DEL are percent-encoded.
+static void replyName(FILE* out, const char* name) {
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        if (*p <= 0x20 || *p == '%' || *p == 0x7f) {
+            fprintf(out, "%%%02X", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+}
+
+static void convertRequest(const Server* s, Worker* w, const char* buf, size_t len,
+                           const char* outDir, const char* error, FILE* out) {
+    SymbolTable st;
+    initSymbolTable(&st);
+    int ok;
+    if (s->stream) {
+        ok = streamConvert(&st, buf, len, 1);
+    } else {
+        ok = parseDocument(&w->parse, buf, len, &st.keys, 1) == 0 && w->parse.root;
+        if (ok) walkDocument(&st, w->parse.root, 1);
+        parseReset(&w->parse);
+    }
+
+    if (!ok) {
+        replyError(out, error, "conversion failed");
+    } else if (outDir && !saveSymbolTableToCSV(&st, outDir, 1, NULL)) {
+        replyError(out, error, "could not write CSV files");
+    } else {
+        int tables = 0;
+        for (int i = 0; i < st.registry.count; i++) {
+            if (st.registry.tables[i]->rowCount) tables++;
+        }
+        fprintf(out, "OK %d\n", tables);
+        for (int i = 0; i < st.registry.count; i++) {
+            const Table* t = st.registry.tables[i];
+            if (!t->rowCount) continue;
+            replyName(out, t->name);
+            fprintf(out, " %d\n", t->rowCount);
+        }
+    }
+    freeSymbolTables(&st);
+}
+
+static Connection* openConnection(int fd) {
+    Connection* c = calloc(1, sizeof(Connection));
+    if (!c || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        logError("Could not set up connection: %s", c ? strerror(errno) : "out of memory");
+        close(fd);
+        free(c);
+        return NULL;
+    }
+    c->fd = fd;
+    return c;
+}
+
+static void closeConnection(Connection* c) {
+    close(c->fd);
+    free(c->buf);
+    free(c->reply);
+    free(c);
+}
+
+// Sets the reply of a request the poller rejects without a worker; the
+// connection is closed once it is sent.
+static void refuseRequest(Connection* c, const char* reply) {
+    c->reply = strdup(reply);
+    c->replyLen = c->reply ? strlen(reply) : 0;
+    c->replySent = 0;
+    c->closing = 1;
+}
+
+// Looks for a complete request at pos: a line, and for DATA the payload
+// after it. Returns its length, 0 if more input is needed, or -1 if the
+// request line is too long. A DATA line whose length does not parse is
+// complete by itself; the worker rejects it.
+static ssize_t completeRequest(Connection* c, size_t* need) {
+    const char* start = c->buf + c->pos;
+    size_t avail = c->len - c->pos;
+    const char* nl = memchr(start, '\n', avail);
+    if (!nl) {
+        *need = avail + SERVER_READ_SIZE;
+        return avail >= SERVER_MAX_LINE ? -1 : 0;
+    }
+    size_t line = (size_t)(nl - start) + 1;
+    size_t payload = 0;
+    if (line > 5 && memcmp(start, "DATA ", 5) == 0) {
+        const char* arg = nl;
+        while (arg > start && arg[-1] != ' ') arg--;
+        char* end;
+        unsigned long long n = strtoull(arg, &end, 10);
+        if (arg != nl && end == nl && n <= SERVER_MAX_PAYLOAD) payload = (size_t)n;
+    }
+    *need = line + payload;
+    return avail >= line + payload ? (ssize_t)(line + payload) : 0;
+}
+
+// Reads what the client has sent without blocking, stopping once a whole
+// request is buffered. Returns 0 if the connection failed.
+static int fillConnection(Connection* c) {
+    for (;;) {
+        size_t need;
+        ssize_t complete = completeRequest(c, &need);
+        if (complete < 0) {
+            refuseRequest(c, "ERROR request line too long\n");
+            return 1;
+        }
+        if (complete > 0) {
+            c->request = (size_t)complete;
+            return 1;
+        }
+        if (c->eof) return 1;
+        if (c->pos > 0) {
+            memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+            c->len -= c->pos;
+            c->pos = 0;
+        }
+        if (c->len == c->cap) {
+            size_t cap = c->cap ? c->cap * 2 : SERVER_READ_SIZE;
+            if (cap < need) cap = need;
+            char* buf = realloc(c->buf, cap);
+            if (!buf) {
+                logError("Memory allocation failed for request of %zu bytes", need);
+                return 0;
+            }
+            c->buf = buf;
+            c->cap = cap;
+        }
+        ssize_t n = read(c->fd, c->buf + c->len, c->cap - c->len);
+        if (n > 0) {
+            c->len += (size_t)n;
+        } else if (n == 0) {
+            c->eof = 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 1;
+        } else if (errno != EINTR) {
+            return 0;
+        }
+    }
+}
+
+// Sends as much of the reply as the socket takes. Returns 0 if the
+// connection failed.
+static int flushReply(Connection* c) {
+    while (c->replySent < c->replyLen) {
+        ssize_t n = write(c->fd, c->reply + c->replySent, c->replyLen - c->replySent);
+        if (n > 0) {
+            c->replySent += (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 1;
+        } else if (n < 0 && errno != EINTR) {
+            return 0;
+        }
+    }
+    free(c->reply);
+    c->reply = NULL;
+    c->replyLen = c->replySent = 0;
+    return 1;
+}
+
+// Answers the request buffered at pos into c->reply and consumes it.
+static void serveRequest(const Server* s, Worker* w, Connection* c) {
+    char* request = c->buf + c->pos;
+    char* payload = memchr(request, '\n', c->request);
+    *payload++ = '\0';
+    size_t payloadLen = c->request - (size_t)(payload - request);
+    c->pos += c->request;
+    c->request = 0;
+
+    FILE* out = open_memstream(&c->reply, &c->replyLen);
+    if (!out) {
+        logError("Could not allocate reply: %s", strerror(errno));
+        c->closing = 1;
+        return;
+    }
+    c->replySent = 0;
+
+    char error[256];
+    logCaptureErrors(error, sizeof(error));
+
+    // <command> <out-dir> <argument>
+    char* outDir = strchr(request, ' ');
+    char* arg = outDir ? strchr(outDir + 1, ' ') : NULL;
+    if (!arg) {
+        fprintf(out, "ERROR malformed request\n");
+        c->closing = 1;
+    } else {
+        *outDir++ = '\0';
+        *arg++ = '\0';
+        const char* dir = strcmp(outDir, "-") == 0 ? NULL : outDir;
+
+        if (strcmp(request, "FILE") == 0) {
+            InputBuffer input;
+            if (!inputOpenFile(&input, arg)) {
+                replyError(out, error, "could not open input");
+            } else {
+                convertRequest(s, w, input.data, input.len, dir, error, out);
+                inputClose(&input);
+            }
+        } else if (strcmp(request, "DATA") == 0) {
+            char* end;
+            unsigned long long len = strtoull(arg, &end, 10);
+            if (end == arg || *end || len > SERVER_MAX_PAYLOAD || len != payloadLen) {
+                fprintf(out, "ERROR bad payload length\n");
+                c->closing = 1;
+            } else {
+                convertRequest(s, w, payload, payloadLen, dir, error, out);
+            }
+        } else {
+            fprintf(out, "ERROR unknown request '%s'\n", request);
+            c->closing = 1;
+        }
+    }
+    logCaptureErrors(NULL, 0);
+    if (fclose(out) != 0) c->closing = 1;
+}
+
+static void pushReady(Server* s, Connection* c) {
+    c->next = NULL;
+    pthread_mutex_lock(&s->lock);
+    if (s->readyTail) {
+        s->readyTail->next = c;
+    } else {
+        s->readyHead = c;
+    }
+    s->readyTail = c;
+    pthread_cond_signal(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Gives an answered connection back to the poller to send the reply.
+static void handBack(Server* s, Connection* c) {
+    pthread_mutex_lock(&s->lock);
+    c->next = s->done;
+    s->done = c;
+    pthread_mutex_unlock(&s->lock);
+    ssize_t n;
+    do {
+        n = write(s->wakeFds[1], "", 1);
+    } while (n < 0 && errno == EINTR);
+}
+
+static void* serveWorker(void* ctx) {
+    Server* s = ctx;
+    Worker w;
+    memset(&w, 0, sizeof(w));
+    parseInit(&w.parse);
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->readyHead && !s->stopping) {
+            pthread_cond_wait(&s->ready, &s->lock);
+        }
+        Connection* c = s->readyHead;
+        if (c) {
+            s->readyHead = c->next;
+            if (!s->readyHead) s->readyTail = NULL;
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (!c) break;
+
+        serveRequest(s, &w, c);
+        handBack(s, c);
+    }
+    parseFree(&w.parse);
+    return NULL;
+}
+
+// Connections the poller waits on; fds has two more slots, for the
+// listening socket and the wake-up pipe.
+typedef struct {
+    Connection** conns;
+    struct pollfd* fds;
+    int count;
+    int cap;
+} WatchList;
+
+static void watchConnection(WatchList* wl, Connection* c) {
+    if (wl->count == wl->cap) {
+        int cap = wl->cap ? wl->cap * 2 : 64;
+        Connection** conns = realloc(wl->conns, sizeof(Connection*) * cap);
+        if (conns) wl->conns = conns;
+        struct pollfd* fds = conns ? realloc(wl->fds, sizeof(struct pollfd) * (cap + 2)) : NULL;
+        if (fds) wl->fds = fds;
+        if (!conns || !fds) {
+            logError("Memory allocation failed for connection list");
+            closeConnection(c);
+            return;
+        }
+        wl->cap = cap;
+    }
+    wl->conns[wl->count++] = c;
+}
+
+// Moves a connection on as far as it can go without blocking: sends its
+// reply, reads the next request and passes it to a worker once complete.
+// Returns 1 if the connection is still to be watched.
+static int advanceConnection(Server* s, Connection* c) {
+    for (;;) {
+        if (c->reply && !flushReply(c)) break;
+        if (c->reply) return 1;
+        if (c->closing || !fillConnection(c)) break;
+        if (c->request) {
+            pushReady(s, c);
+            return 0;
+        }
+        if (c->reply) continue;
+        if (c->eof) break;
+        return 1;
+    }
+    closeConnection(c);
+    return 0;
+}
+
+// Accepts connections, does their I/O and hands complete requests to the
+// workers until accept() or poll() fails.
+static void pollConnections(Server* s) {
+    WatchList wl = { NULL, malloc(sizeof(struct pollfd) * 2), 0, 0 };
+    if (!wl.fds) {
+        logError("Memory allocation failed for connection list");
+        return;
+    }
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        Connection* done = s->done;
+        s->done = NULL;
+        pthread_mutex_unlock(&s->lock);
+        while (done) {
+            Connection* next = done->next;
+            if (advanceConnection(s, done)) watchConnection(&wl, done);
+            done = next;
+        }
+
+        struct pollfd* fds = wl.fds;
+        fds[0].fd = s->listenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = s->wakeFds[0];
+        fds[1].events = POLLIN;
+        for (int i = 0; i < wl.count; i++) {
+            fds[i + 2].fd = wl.conns[i]->fd;
+            fds[i + 2].events = wl.conns[i]->reply ? POLLOUT : POLLIN;
+        }
+        if (poll(fds, (nfds_t)wl.count + 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            logError("poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents) {
+            char drain[64];
+            while (read(s->wakeFds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        int kept = 0;
+        for (int i = 0; i < wl.count; i++) {
+            if (!fds[i + 2].revents || advanceConnection(s, wl.conns[i])) {
+                wl.conns[kept++] = wl.conns[i];
+            }
+        }
+        wl.count = kept;
+
+        if (fds[0].revents) {
+            int fd = accept(s->listenFd, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                logError("accept failed: %s", strerror(errno));
+                break;
+            }
+            Connection* c = openConnection(fd);
+            if (c) watchConnection(&wl, c);
+        }
+    }
+
+    for (int i = 0; i < wl.count; i++) {
+        closeConnection(wl.conns[i]);
+    }
+    free(wl.conns);
+    free(wl.fds);
+}
+
+// Serves conversions on --jobs worker threads until killed. The socket
+// file is removed on SIGINT and SIGTERM. Returns 0 if the socket could not
+// be set up.
+int serveSocket(const char* path, int stream) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        logError("Socket path '%s' is too long", path);
+        return 0;
+    }
+    strcpy(addr.sun_path, path);
+
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    server.stream = stream;
+    if (server.listenFd < 0) {
+        logError("Could not create socket: %s", strerror(errno));
+        return 0;
+    }
+    if (pipe(server.wakeFds) != 0) {
+        logError("Could not create wake-up pipe: %s", strerror(errno));
+        close(server.listenFd);
+        return 0;
+    }
+    // Neither end may block: a full pipe already means the poller will wake
+    fcntl(server.wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(server.wakeFds[1], F_SETFL, O_NONBLOCK);
+    unlink(path);
+    if (bind(server.listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(server.listenFd, SERVER_BACKLOG) != 0) {
+        logError("Could not listen on '%s': %s", path, strerror(errno));
+        close(server.listenFd);
+        close(server.wakeFds[0]);
+        close(server.wakeFds[1]);
+        return 0;
+    }
+
+    socketPath = path;
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    // Replies list the tables; nobody reads the daemon's stdout per file
+    csvPrintSaved = 0;
+
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready, NULL);
+    int jobs = parallelJobCount();
+    pthread_t* threads = malloc(sizeof(pthread_t) * jobs);
+    int started = 0;
+    while (threads && started < jobs && pthread_create(&threads[started], NULL, serveWorker, &server) == 0) {
+        started++;
+    }
+
+    if (started == 0) {
+        logError("Could not start worker threads");
+    } else {
+        printf("Listening on %s with %d workers\n", path, started);
+        fflush(stdout);
+        pollConnections(&server);
+    }
+
+    pthread_mutex_lock(&server.lock);
+    server.stopping = 1;
+    pthread_cond_broadcast(&server.ready);
+    pthread_mutex_unlock(&server.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    while (server.done) {
+        Connection* next = server.done->next;
+        closeConnection(server.done);
+        server.done = next;
+    }
+    pthread_cond_destroy(&server.ready);
+    pthread_mutex_destroy(&server.lock);
+
+    close(server.listenFd);
+    close(server.wakeFds[0]);
+    close(server.wakeFds[1]);
+    unlink(path);
+    return 1;
+}
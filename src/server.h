@@ -0,0 +1,17 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Conversion server on a Unix domain socket. Each connection sends any
+// number of requests, one after another:
+//
+//   FILE <out-dir> <path>\n            convert a file
+//   DATA <out-dir> <length>\n<bytes>   convert the payload that follows
+//
+// <out-dir> is "-" to convert without writing CSV files. Every request is
+// answered with "OK <n>\n" followed by n "<table> <rows>\n" lines, one per
+// non-empty table, or with "ERROR <message>\n" holding the first error
+// logged while converting. Table names come from the input, so bytes up to
+// and including space, '%' and DEL are sent as %XX.
+int serveSocket(const char* path, int stream);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SLICE_H
+#define SLICE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLICE_OWNED 0x1     // ptr was malloc'd and is freed with its owner
+#define SLICE_TRANSIENT 0x2 // ptr lives only as long as the lexer (decoded escapes); copy to keep
+#define SLICE_MAX_LEN UINT32_MAX    // Longer tokens are rejected by the lexer
+
+// A string that lives elsewhere, normally inside the input buffer.
+// It is not NUL-terminated; always use len.
+typedef struct {
+    const char* ptr;
+    uint32_t len;
+    uint32_t flags;
+} Slice;
+
+static inline Slice sliceOf(const char* s) {
+    Slice sl = { s, s ? (uint32_t)strlen(s) : 0, 0 };
+    return sl;
+}
+
+static inline Slice sliceOwned(char* s) {
+    Slice sl = { s, s ? (uint32_t)strlen(s) : 0, SLICE_OWNED };
+    return sl;
+}
+
+static inline int sliceEq(Slice a, Slice b) {
+    return a.len == b.len && memcmp(a.ptr, b.ptr, a.len) == 0;
+}
+
+static inline int sliceEqStr(Slice a, const char* s) {
+    return s && strlen(s) == a.len && memcmp(a.ptr, s, a.len) == 0;
+}
+
+static inline int sliceCmp(Slice a, Slice b) {
+    uint32_t n = a.len < b.len ? a.len : b.len;
+    int c = memcmp(a.ptr, b.ptr, n);
+    if (c != 0) return c;
+    return (a.len > b.len) - (a.len < b.len);
+}
+
+// Returns a NUL-terminated heap copy, for the few places that need one.
+static inline char* sliceDup(Slice s) {
+    char* out = malloc((size_t)s.len + 1);
+    if (!out) return NULL;
+    memcpy(out, s.ptr, s.len);
+    out[s.len] = '\0';
+    return out;
+}
+
+static inline void sliceFree(Slice* s) {
+    if (s->flags & SLICE_OWNED) free((char*)s->ptr);
+    s->ptr = NULL;
+    s->len = 0;
+    s->flags = 0;
+}
+
+#endif
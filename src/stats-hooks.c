@@ -0,0 +1,30 @@
+#include <time.h>
+#include "stats.h"
+
+// The hooks the conversion calls; the reports are in stats.c, which the
+// library leaves out.
+
+int statsEnabled = 0;
+Stats j2r_stats;
+
+static double wallStart[STATS_PHASE_COUNT];
+static double cpuStart[STATS_PHASE_COUNT];
+
+static double seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void statsStart(StatsPhase phase) {
+    if (!statsEnabled) return;
+    wallStart[phase] = seconds(CLOCK_MONOTONIC);
+    cpuStart[phase] = seconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+// A phase may run several times (e.g. once per document); its times add up.
+void statsStop(StatsPhase phase) {
+    if (!statsEnabled) return;
+    j2r_stats.wall[phase] += seconds(CLOCK_MONOTONIC) - wallStart[phase];
+    j2r_stats.cpu[phase] += seconds(CLOCK_PROCESS_CPUTIME_ID) - cpuStart[phase];
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "stats.h"
+
+static const char* const phaseNames[STATS_PHASE_COUNT] = {
+    "read", "lex", "parse", "walk", "write"
+};
+
+static double perSecond(double amount, double secs) {
+    return secs > 0 ? amount / secs : 0;
+}
+
+// Peak resident set size in KiB.
+static long peakRss(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+// Bytes currently allocated with malloc, where the C library tells.
+static size_t heapInUse(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static double lexParseWall(void) {
+    return j2r_stats.wall[STATS_LEX] + j2r_stats.wall[STATS_PARSE];
+}
+
+void statsReport(FILE* out, const SymbolTable* st, const size_t* bytesWritten) {
+    double mb = (double)j2r_stats.inputBytes / 1e6;
+    double wall = 0, cpu = 0;
+    fprintf(out, "\n------------------------- Statistics -------------------------\n\n");
+    fprintf(out, "%-8s %12s %12s %10s\n", "phase", "wall ms", "cpu ms", "MB/s");
+    for (int p = 0; p < STATS_PHASE_COUNT; p++) {
+        fprintf(out, "%-8s %12.3f %12.3f %10.1f\n", phaseNames[p], j2r_stats.wall[p] * 1e3,
+                j2r_stats.cpu[p] * 1e3, perSecond(mb, j2r_stats.wall[p]));
+        wall += j2r_stats.wall[p];
+        cpu += j2r_stats.cpu[p];
+    }
+    fprintf(out, "%-8s %12.3f %12.3f %10.1f\n\n", "total", wall * 1e3, cpu * 1e3, perSecond(mb, wall));
+
+    fprintf(out, "Input:      %zu bytes\n", j2r_stats.inputBytes);
+    fprintf(out, "Tokens:     %zu (%.0f/s)\n", j2r_stats.tokens, perSecond((double)j2r_stats.tokens, lexParseWall()));
+    fprintf(out, "AST nodes:  %zu\n", j2r_stats.nodes);
+    fprintf(out, "AST arena:  %zu allocations, %zu bytes in %zu blocks\n",
+            j2r_stats.arenaAllocs, j2r_stats.arenaBytes, j2r_stats.arenaBlocks);
+    fprintf(out, "Heap:       %zu bytes in use\n", heapInUse());
+    fprintf(out, "Peak RSS:   %ld KiB\n\n", peakRss());
+
+    fprintf(out, "%-24s %10s %8s %14s\n", "table", "rows", "columns", "bytes written");
+    for (int i = 0; i < st->registry.count; i++) {
+        const Table* t = st->registry.tables[i];
+        fprintf(out, "%-24s %10d %8d %14zu\n", t->name, t->rowsSpilled + t->rowCount, t->columnCount,
+                bytesWritten ? bytesWritten[i] : 0);
+    }
+}
+
+static void jsonString(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Same figures as statsReport(), as one JSON object.
+void statsReportJson(FILE* out, const SymbolTable* st, const size_t* bytesWritten) {
+    double mb = (double)j2r_stats.inputBytes / 1e6;
+    double wall = 0, cpu = 0;
+    fprintf(out, "{\"phases\":{");
+    for (int p = 0; p < STATS_PHASE_COUNT; p++) {
+        fprintf(out, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"mb_per_s\":%.1f}", p ? "," : "",
+                phaseNames[p], j2r_stats.wall[p] * 1e3, j2r_stats.cpu[p] * 1e3, perSecond(mb, j2r_stats.wall[p]));
+        wall += j2r_stats.wall[p];
+        cpu += j2r_stats.cpu[p];
+    }
+    fprintf(out, "},\"total\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"mb_per_s\":%.1f}",
+            wall * 1e3, cpu * 1e3, perSecond(mb, wall));
+    fprintf(out, ",\"input_bytes\":%zu,\"tokens\":%zu,\"tokens_per_s\":%.0f,\"ast_nodes\":%zu",
+            j2r_stats.inputBytes, j2r_stats.tokens, perSecond((double)j2r_stats.tokens, lexParseWall()), j2r_stats.nodes);
+    fprintf(out, ",\"arena\":{\"allocations\":%zu,\"bytes\":%zu,\"blocks\":%zu}",
+            j2r_stats.arenaAllocs, j2r_stats.arenaBytes, j2r_stats.arenaBlocks);
+    fprintf(out, ",\"heap_bytes\":%zu,\"peak_rss_kib\":%ld,\"tables\":[", heapInUse(), peakRss());
+    for (int i = 0; i < st->registry.count; i++) {
+        const Table* t = st->registry.tables[i];
+        fprintf(out, "%s{\"name\":", i ? "," : "");
+        jsonString(out, t->name);
+        fprintf(out, ",\"rows\":%d,\"columns\":%d,\"bytes_written\":%zu}", t->rowsSpilled + t->rowCount, t->columnCount,
+                bytesWritten ? bytesWritten[i] : 0);
+    }
+    fprintf(out, "]}\n");
+}
@@ -0,0 +1,40 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "symbol_table.h"
+
+// Timing and size figures for one conversion, printed by --stats and
+// --stats-json. Phases are timed on the calling thread; CPU time is that
+// of the whole process, so it includes the threads a phase starts.
+
+typedef enum {
+    STATS_READ,
+    STATS_LEX,
+    STATS_PARSE,
+    STATS_WALK,
+    STATS_WRITE,
+    STATS_PHASE_COUNT
+} StatsPhase;
+
+typedef struct {
+    double wall[STATS_PHASE_COUNT];    // Seconds
+    double cpu[STATS_PHASE_COUNT];     // Seconds
+    size_t inputBytes;
+    size_t tokens;
+    size_t nodes;       // AST nodes, 0 without an AST
+    size_t arenaAllocs; // AST arena allocations
+    size_t arenaBytes;
+    size_t arenaBlocks;
+} Stats;
+
+extern int statsEnabled;    // Set by --stats / --stats-json; the hooks do nothing otherwise
+extern Stats j2r_stats;      // Figures of the current conversion
+
+void statsStart(StatsPhase phase);
+void statsStop(StatsPhase phase);
+void statsReport(FILE* out, const SymbolTable* st, const size_t* bytesWritten);
+void statsReportJson(FILE* out, const SymbolTable* st, const size_t* bytesWritten);
+
+#endif
@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "intern.h"
+#include "stats.h"
+#include "log.h"
+
+// Streaming conversion. streamParse() checks the tokens against the same
+// grammar as parser.y and reports them as events; the builder below turns
+// those events into the rows walkAST() would produce, keeping only the
+// objects and arrays that are still open.
+
+typedef enum {
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_END,    // After '['
+    EXPECT_KEY,             // After ',' in an object
+    EXPECT_KEY_OR_END,      // After '{'
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_END,
+    EXPECT_EOF
+} ParseState;
+
+static int syntaxError(const Lexer* lx) {
+    int line, col;
+    if (lexerFailed(lx)) return 0;
+    lexerPosition(lx, lx->tokEnd, &line, &col);
+    logError("Parse error at line %d, col %d: syntax error", line, col);
+    return 0;
+}
+
+static int scalarToken(int tok, const YYSTYPE* lval, Value* v) {
+    switch (tok) {
+        case STRING:
+            v->type = VALUE_STRING;
+            v->as.s = lval->str.text;
+            return 1;
+        case NUMBER:
+            v->type = VALUE_NUMBER;
+            v->as.s = lval->strVal;
+            return 1;
+        case TRUE:
+        case FALSE:
+            v->type = VALUE_BOOL;
+            v->as.b = tok == TRUE;
+            return 1;
+        case NULLTOK:
+            *v = nullValue();
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Only the kinds of the open containers are kept, so memory grows with
+// nesting depth and not with document size. Returns 1 if the whole input
+// was a valid document and the handler accepted every event.
+int streamParse(Lexer* lx, StreamHandler handler, void* ctx) {
+    char* open = NULL;
+    int depth = 0;
+    int cap = 0;
+    int ok = 0;
+    ParseState state = EXPECT_VALUE;
+    StreamEvent ev;
+    YYSTYPE lval;
+
+    for (;;) {
+        int tok = lexerNext(lx, &lval);
+        int valueDone = 0;
+        memset(&ev, 0, sizeof(ev));
+
+        switch (state) {
+            case EXPECT_VALUE_OR_END:
+                if (tok == RIGHT_BRACKET) {
+                    ev.kind = EVENT_END_ARRAY;
+                    depth--;
+                    valueDone = 1;
+                    break;
+                }
+                // fall through
+            case EXPECT_VALUE:
+                if (tok == LEFT_BRACE || tok == LEFT_BRACKET) {
+                    if (depth == cap) {
+                        cap = cap ? cap * 2 : 64;
+                        char* grown = realloc(open, cap);
+                        if (!grown) {
+                            logError("Memory allocation failed for nesting stack");
+                            goto done;
+                        }
+                        open = grown;
+                    }
+                    int isObject = tok == LEFT_BRACE;
+                    open[depth++] = isObject ? '{' : '[';
+                    ev.kind = isObject ? EVENT_START_OBJECT : EVENT_START_ARRAY;
+                    state = isObject ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+                } else if (scalarToken(tok, &lval, &ev.value)) {
+                    ev.kind = EVENT_SCALAR;
+                    valueDone = 1;
+                } else {
+                    syntaxError(lx);
+                    goto done;
+                }
+                break;
+            case EXPECT_KEY_OR_END:
+                if (tok == RIGHT_BRACE) {
+                    ev.kind = EVENT_END_OBJECT;
+                    depth--;
+                    valueDone = 1;
+                    break;
+                }
+                // fall through
+            case EXPECT_KEY:
+                if (tok != STRING) {
+                    syntaxError(lx);
+                    goto done;
+                }
+                ev.kind = EVENT_KEY;
+                ev.key = lval.str.text;
+                ev.keyId = lval.str.keyId;
+                state = EXPECT_COLON;
+                break;
+            case EXPECT_COLON:
+                if (tok != COLON) {
+                    syntaxError(lx);
+                    goto done;
+                }
+                state = EXPECT_VALUE;
+                continue;
+            case EXPECT_COMMA_OR_END:
+                if (tok == COMMA) {
+                    state = open[depth - 1] == '{' ? EXPECT_KEY : EXPECT_VALUE;
+                    continue;
+                }
+                if (tok != (open[depth - 1] == '{' ? RIGHT_BRACE : RIGHT_BRACKET)) {
+                    syntaxError(lx);
+                    goto done;
+                }
+                ev.kind = open[depth - 1] == '{' ? EVENT_END_OBJECT : EVENT_END_ARRAY;
+                depth--;
+                valueDone = 1;
+                break;
+            case EXPECT_EOF:
+                if (tok != YYEOF) {
+                    syntaxError(lx);
+                    goto done;
+                }
+                ok = 1;
+                goto done;
+        }
+
+        if (valueDone) {
+            state = depth ? EXPECT_COMMA_OR_END : EXPECT_EOF;
+        }
+        if (!handler(ctx, &ev)) {
+            goto done;
+        }
+    }
+
+done:
+    free(open);
+    return ok;
+}
+
+typedef struct {
+    int isArray;
+    int isRoot;         // A top-level object
+    int isRecords;      // A top-level array, whose objects are top-level objects
+    Slice name;         // Key this container is the value of
+    int parentId;       // Row holding this container
+    int seq;            // Position in the enclosing array, -1 otherwise
+    int serial;         // Where walkAST() would have created its table
+
+    // Objects
+    int id;             // Row id, taken at the first key (0 for {})
+    int* keyIds;        // Keys in document order
+    Value* values;      // values[k] belongs to keyIds[k]
+    int keyCount;
+    int keyCap;
+
+    // Arrays
+    int count;          // Elements seen so far
+    int objectArray;    // Set by the first non-empty object element
+    Value* scalars;     // Element values, kept until the array is known to hold no objects
+    int buffered;       // Number of them
+    int scalarCap;
+} Frame;
+
+typedef struct {
+    SymbolTable* st;
+    RowSink sink;       // Receives tables as rows are added to them, if set
+    void* sinkCtx;
+    Frame* frames;      // Open containers; buffers are reused across siblings
+    int depth;
+    int cap;
+    int skipDepth;      // > 0 while inside a subtree walkAST() would not visit
+    int rootlessArrays; // Arrays walkAST() rejects for having no parent table
+} StreamBuilder;
+
+static Frame* pushFrame(StreamBuilder* b, int isArray, Slice name, int parentId, int seq) {
+    if (b->depth == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 16;
+        Frame* frames = realloc(b->frames, sizeof(Frame) * cap);
+        if (!frames) {
+            logError("Memory allocation failed for streaming state");
+            return NULL;
+        }
+        memset(frames + b->cap, 0, sizeof(Frame) * (cap - b->cap));
+        b->frames = frames;
+        b->cap = cap;
+    }
+    Frame* f = &b->frames[b->depth++];
+    f->isArray = isArray;
+    f->isRoot = 0;
+    f->isRecords = 0;
+    f->name = name;
+    f->parentId = parentId;
+    f->seq = seq;
+    f->serial = isArray ? b->st->serialCounter++ : 0;
+    f->id = 0;
+    f->keyCount = 0;
+    f->count = 0;
+    f->objectArray = 0;
+    f->buffered = 0;
+    return f;
+}
+
+// Values kept in a frame outlive the token they came from, so decoded
+// strings, which the lexer drops at its next window, are copied.
+static int keepValue(Value* v) {
+    if (!valueHasText(v->type) || !(v->as.s.flags & SLICE_TRANSIENT)) return 1;
+    char* copy = sliceDup(v->as.s);
+    if (!copy) {
+        logError("Memory allocation failed for string value");
+        return 0;
+    }
+    v->as.s.ptr = copy;
+    v->as.s.flags = SLICE_OWNED;
+    return 1;
+}
+
+static void dropValues(Value* values, int count) {
+    for (int i = 0; i < count; i++) {
+        if (valueHasText(values[i].type)) sliceFree(&values[i].as.s);
+    }
+}
+
+// Stores the value of the next element of a scalar array.
+static int bufferScalar(Frame* f, Value v) {
+    int i = f->count - 1;
+    if (i >= f->scalarCap) {
+        int cap = f->scalarCap ? f->scalarCap * 2 : 16;
+        Value* scalars = realloc(f->scalars, sizeof(Value) * cap);
+        if (!scalars) {
+            logError("Memory allocation failed for array elements");
+            return 0;
+        }
+        f->scalars = scalars;
+        f->scalarCap = cap;
+    }
+    f->scalars[i] = v;
+    f->buffered = i + 1;
+    return 1;
+}
+
+static int startContainer(StreamBuilder* b, Frame* top, int isArray) {
+    if (!top || top->isRecords) {
+        if (isArray && top) {
+            // Reported once the whole document has parsed, like walkAST()
+            b->rootlessArrays++;
+            b->skipDepth = 1;
+            return 1;
+        }
+        Frame* f = pushFrame(b, isArray, sliceOf("objects"), 0, -1);
+        if (!f) return 0;
+        f->isRoot = !isArray;
+        f->isRecords = isArray;
+        return 1;
+    }
+
+    if (!top->isArray) {
+        top->values[top->keyCount - 1] = placeholderValue();
+        Slice key = internedSlice(&b->st->keys, top->keyIds[top->keyCount - 1]);
+        return pushFrame(b, isArray, key, top->id, -1) != NULL;
+    }
+
+    top->count++;
+    if (isArray) {
+        // Arrays inside arrays are placeholders and their contents are
+        // never walked
+        b->skipDepth = 1;
+        return top->objectArray || bufferScalar(top, placeholderValue());
+    }
+    return pushFrame(b, 0, top->name, top->parentId, top->count - 1) != NULL;
+}
+
+static int addKey(StreamBuilder* b, Frame* f, Slice key, int id) {
+    if (f->keyCount == 0) {
+        // Only now is this a non-empty object that gets a row
+        f->id = b->st->idCounter++;
+        f->serial = b->st->serialCounter++;
+        Frame* parent = b->depth > 1 ? &b->frames[b->depth - 2] : NULL;
+        if (parent && parent->isArray && !parent->objectArray) {
+            // The scalars before this element never become rows
+            parent->objectArray = 1;
+            dropValues(parent->scalars, parent->buffered);
+        }
+    }
+
+    if (id < 0) id = internSlice(&b->st->keys, key);
+    if (id < 0) return 0;
+    if (f->keyCount == f->keyCap) {
+        int cap = f->keyCap ? f->keyCap * 2 : 16;
+        int* keyIds = realloc(f->keyIds, sizeof(int) * cap);
+        if (!keyIds) return 0;
+        f->keyIds = keyIds;
+        Value* values = realloc(f->values, sizeof(Value) * cap);
+        if (!values) return 0;
+        f->values = values;
+        f->keyCap = cap;
+    }
+    f->keyIds[f->keyCount] = id;
+    f->values[f->keyCount] = nullValue();
+    f->keyCount++;
+    return 1;
+}
+
+static int addScalar(Frame* top, Value v) {
+    if (!top || top->isRecords) return 1; // Bare scalars have no rows
+    if (!top->isArray) {
+        if (!keepValue(&v)) return 0;
+        top->values[top->keyCount - 1] = v;
+        return 1;
+    }
+    top->count++;
+    if (top->objectArray) return 1;
+    if (!keepValue(&v)) return 0;
+    if (!bufferScalar(top, v)) {
+        dropValues(&v, 1);
+        return 0;
+    }
+    return 1;
+}
+
+static int endObject(StreamBuilder* b) {
+    Frame* f = &b->frames[--b->depth];
+    Frame* parent = b->depth ? &b->frames[b->depth - 1] : NULL;
+    if (f->keyCount == 0) {
+        // {} is a placeholder, not an object row
+        if (parent && parent->isArray && !parent->objectArray && !parent->isRecords) {
+            return bufferScalar(parent, placeholderValue());
+        }
+        return 1;
+    }
+
+    Schema schema;
+    objectSchema(f->keyIds, f->keyCount, &schema);
+    char* name = f->isRoot ? strdup("objects") : sliceDup(f->name);
+    if (!name) {
+        j2r_report_error("Memory allocation failed for table name", "streamConvert", nodeKindName(NODE_OBJECT));
+        return 0;
+    }
+    Table* table = findOrCreateTableAt(b->st, &schema, name, f->isRoot ? NULL : name, f->serial);
+    if (table) {
+        addObjectRow(b->st, table, f->id, f->parentId, f->seq, f->keyIds, f->values, f->keyCount);
+    }
+    free(name);
+    if (!table) return 0;
+    return !b->sink || b->sink(b->sinkCtx, b->st, table);
+}
+
+// The scalar rows of an array are only added once it is known to hold no
+// objects. Its table is created without a parent name, which
+// streamFinish() or mergeSymbolTable() fills in.
+static int endArray(StreamBuilder* b) {
+    SymbolTable* st = b->st;
+    Frame* f = &b->frames[--b->depth];
+    if (f->objectArray || f->isRecords) return 1;
+
+    int idBuf[1];
+    Schema schema;
+    char* name = sliceDup(f->name);
+    int indexId = internSlice(&st->keys, sliceOf("index"));
+    int valueId = internSlice(&st->keys, sliceOf("value"));
+    Table* table = NULL;
+    if (name && indexId >= 0 && valueId >= 0 && scalarArraySchema(st, f->name, &schema, idBuf)) {
+        table = findOrCreateTableAt(st, &schema, name, NULL, f->serial);
+    }
+    free(name);
+    if (!table) return 0;
+
+    for (int i = 0; i < f->count; i++) {
+        int row = addRow(table, st->idCounter++, f->parentId);
+        if (row < 0) return 0;
+        setCell(table, row, indexId, intValue(i), 0);
+        setCell(table, row, valueId, f->scalars[i], 1);
+    }
+    return !b->sink || b->sink(b->sinkCtx, st, table);
+}
+
+static int onEvent(void* ctx, const StreamEvent* ev) {
+    StreamBuilder* b = ctx;
+    if (b->skipDepth) {
+        if (ev->kind == EVENT_START_OBJECT || ev->kind == EVENT_START_ARRAY) b->skipDepth++;
+        if (ev->kind == EVENT_END_OBJECT || ev->kind == EVENT_END_ARRAY) b->skipDepth--;
+        return 1;
+    }
+
+    Frame* top = b->depth ? &b->frames[b->depth - 1] : NULL;
+    switch (ev->kind) {
+        case EVENT_START_OBJECT:
+            return startContainer(b, top, 0);
+        case EVENT_START_ARRAY:
+            return startContainer(b, top, 1);
+        case EVENT_KEY:
+            return addKey(b, top, ev->key, ev->keyId);
+        case EVENT_SCALAR:
+            return addScalar(top, ev->value);
+        case EVENT_END_OBJECT:
+            return endObject(b);
+        case EVENT_END_ARRAY:
+            return endArray(b);
+    }
+    return 1;
+}
+
+// Puts the tables in the order walkAST() would have created them and
+// gives scalar-array tables the parent name walkAST() would have looked
+// up when creating them.
+void streamFinish(SymbolTable* st) {
+    sortTablesBySerial(st);
+    for (int i = 0; i < st->registry.count; i++) {
+        Table* t = st->registry.tables[i];
+        if (t->schema.kind != SCHEMA_SCALAR_ARRAY || t->parentName) continue;
+        Table* namesake = findTableByName(&st->registry, t->name);
+        const char* grandparentName = namesake && namesake != t ? namesake->parentName : NULL;
+        t->parentName = strdup(grandparentName ? grandparentName : "objects");
+    }
+}
+
+// Builds the rows of an indexed document; see streamConvertRecord().
+static int convertIndexed(SymbolTable* st, Lexer* lx, RowSink sink, void* sinkCtx) {
+    lx->keys = &st->keys;
+    StreamBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.st = st;
+    b.sink = sink;
+    b.sinkCtx = sinkCtx;
+    int firstId = st->idCounter;
+    int tableCount = st->registry.count;
+    int ok = streamParse(lx, onEvent, &b);
+    if (!ok) {
+        discardRowsFrom(st, firstId, tableCount);
+        // Values of the containers left open
+        for (int i = 0; i < b.depth; i++) {
+            Frame* f = &b.frames[i];
+            if (!f->isArray) dropValues(f->values, f->keyCount);
+            else if (!f->objectArray) dropValues(f->scalars, f->buffered);
+        }
+    }
+    for (int i = 0; ok && i < b.rootlessArrays; i++) {
+        j2r_report_error("NULL parentTable for array", "walkAST", nodeKindName(NODE_ARRAY));
+    }
+
+    for (int i = 0; i < b.cap; i++) {
+        free(b.frames[i].keyIds);
+        free(b.frames[i].values);
+        free(b.frames[i].scalars);
+    }
+    free(b.frames);
+    return ok;
+}
+
+// Adds the rows of one document to st without building its AST. Tables
+// stay in the order rows completed until streamFinish(). If the document
+// is invalid, everything it added is removed again. Records are indexed on
+// the calling thread, which is normally one of a pool already.
+int streamConvertRecord(SymbolTable* st, const char* buf, size_t len) {
+    Lexer lx;
+    if (!lexerInit(&lx, buf, len, 1)) {
+        return 0;
+    }
+    int ok = convertIndexed(st, &lx, NULL, NULL);
+    lexerFree(&lx);
+    return ok;
+}
+
+// Lexing, parsing and building rows are one pass here, timed as the walk
+// phase. The input is indexed a window at a time on up to jobs threads.
+int streamConvert(SymbolTable* st, const char* buf, size_t len, int jobs) {
+    return streamConvertTo(st, buf, len, jobs, NULL, NULL);
+}
+
+// Like streamConvert(), handing each table to sink as soon as rows were
+// added to it, so that they need not stay in memory.
+int streamConvertTo(SymbolTable* st, const char* buf, size_t len, int jobs, RowSink sink, void* ctx) {
+    Lexer lx;
+    statsStart(STATS_WALK);
+    int ok = lexerInitWindowed(&lx, buf, len, jobs);
+    if (ok) {
+        ok = convertIndexed(st, &lx, sink, ctx);
+        if (statsEnabled) j2r_stats.tokens += lexerTokenCount(&lx);
+        lexerFree(&lx);
+    }
+    statsStop(STATS_WALK);
+    if (!ok) {
+        return 0;
+    }
+    streamFinish(st);
+    return 1;
+}
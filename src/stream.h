@@ -0,0 +1,37 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include "lexer.h"
+#include "symbol_table.h"
+
+typedef enum {
+    EVENT_START_OBJECT,
+    EVENT_END_OBJECT,
+    EVENT_START_ARRAY,
+    EVENT_END_ARRAY,
+    EVENT_KEY,          // key holds the member name, keyId its id if the lexer interned it
+    EVENT_SCALAR        // value holds a string, number, bool or null
+} StreamEventKind;
+
+typedef struct {
+    StreamEventKind kind;
+    Slice key;
+    int keyId;
+    Value value;
+} StreamEvent;
+
+// Returns 0 to stop parsing.
+typedef int (*StreamHandler)(void* ctx, const StreamEvent* ev);
+
+// Receives a table as soon as rows were added to it, to write them out
+// and drop them (clearTableRows()). Returns 0 to stop the conversion.
+typedef int (*RowSink)(void* ctx, const SymbolTable* st, Table* table);
+
+int streamParse(Lexer* lx, StreamHandler handler, void* ctx);
+int streamConvertRecord(SymbolTable* st, const char* buf, size_t len);
+void streamFinish(SymbolTable* st);
+int streamConvert(SymbolTable* st, const char* buf, size_t len, int jobs);
+int streamConvertTo(SymbolTable* st, const char* buf, size_t len, int jobs, RowSink sink, void* ctx);
+
+#endif
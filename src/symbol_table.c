@@ -2,572 +2,991 @@
 #include <stdlib.h>
 #include <string.h>
 #include "symbol_table.h"
+#include "intern.h"
+#include "log.h"
+#include "number.h"
+#include "parallel.h"
+
+void initSymbolTable(SymbolTable* st) {
+    memset(st, 0, sizeof(*st));
+    st->idCounter = 1;
+}
 
-Table* tables[MAX_TABLES] = {0};
-int tableCount = 0;
-int idCounter = 1;
+void j2r_report_error(const char* message, const char* context, const char* node_type) {
+    logError("%s (Context: %s, Node Type: %s)",
+             message, context ? context : "unknown", node_type ? node_type : "unknown");
+}
 
-void report_error(const char* message, const char* context, const char* node_type) {
-    fprintf(stderr, "Error: %s (Context: %s, Node Type: %s)\n",
-            message, context ? context : "unknown", node_type ? node_type : "unknown");
+static int compareIds(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
 }
 
-char* generateSchemaKey(ASTNode* node) {
-    if (!node || !node->type) {
-        report_error("NULL node or type", "generateSchemaKey", NULL);
-        return strdup("default");
-    }
+static uint64_t schemaSeed(SchemaKind kind) {
+    return mix64(0x5eed0000ULL + (uint64_t)kind);
+}
 
-    if (strcmp(node->type, "object") != 0) {
-        return strdup("default");
+// Fingerprints an object by the ids of its interned keys. The hash is a
+// sum of per-key mixes, so it does not depend on key order and needs no
+// sort; keyIds stay in document order. idBuf is caller storage used when
+// the object has at most idCap keys, otherwise an array is malloc'd.
+int generateSchema(SymbolTable* st, ASTNode* node, Schema* schema, int* idBuf, int idCap) {
+    schema->kind = SCHEMA_OBJECT;
+    schema->hash = schemaSeed(SCHEMA_OBJECT);
+    schema->keyIds = idBuf;
+    schema->keyCount = 0;
+
+    if (!node) {
+        j2r_report_error("NULL node", "generateSchema", NULL);
+        return 1;
+    }
+    if (node->kind != NODE_OBJECT) {
+        return 1;
     }
-
-    char** key_list = NULL;
-    int key_count = 0;
 
     ASTNode* members = NULL;
     for (int i = 0; i < node->childCount; i++) {
-        if (node->children[i] && strcmp(node->children[i]->type, "members") == 0) {
+        if (node->children[i] && node->children[i]->kind == NODE_MEMBERS) {
             members = node->children[i];
             break;
         }
     }
-
     if (!members) {
-        return strdup("default");
+        return 1;
     }
 
-    for (int i = 0; i < members->childCount; i++) {
-        ASTNode* child = members->children[i];
-        if (child && strcmp(child->type, "pair") == 0 && child->strVal) {
-            key_list = realloc(key_list, sizeof(char*) * (key_count + 1));
-            key_list[key_count++] = strdup(child->strVal);
+    if (members->childCount > idCap) {
+        schema->keyIds = malloc(sizeof(int) * members->childCount);
+        if (!schema->keyIds) {
+            j2r_report_error("Memory allocation failed", "generateSchema", nodeKindName(node->kind));
+            schema->keyIds = idBuf;
+            return 0;
         }
     }
 
-    for (int i = 0; i < key_count - 1; i++) {
-        for (int j = i + 1; j < key_count; j++) {
-            if (strcmp(key_list[i], key_list[j]) > 0) {
-                char* temp = key_list[i];
-                key_list[i] = key_list[j];
-                key_list[j] = temp;
+    for (int i = 0; i < members->childCount; i++) {
+        ASTNode* child = members->children[i];
+        if (child && child->kind == NODE_PAIR && child->strVal.ptr) {
+            int id = child->keyId >= 0 ? child->keyId : internSlice(&st->keys, child->strVal);
+            if (id < 0) {
+                freeSchema(schema, idBuf);
+                return 0;
             }
+            schema->keyIds[schema->keyCount++] = id;
+            schema->hash += mix64((uint64_t)id + 1);
         }
     }
+    return 1;
+}
+
+// Same fingerprint as generateSchema(), for keys that were interned as
+// they arrived. The schema borrows keyIds.
+void objectSchema(int* keyIds, int keyCount, Schema* schema) {
+    schema->kind = SCHEMA_OBJECT;
+    schema->hash = schemaSeed(SCHEMA_OBJECT);
+    schema->keyIds = keyIds;
+    schema->keyCount = keyCount;
+    for (int i = 0; i < keyCount; i++) {
+        schema->hash += mix64((uint64_t)keyIds[i] + 1);
+    }
+}
 
-    char* keys = NULL;
-    size_t keys_len = 0;
-    for (int i = 0; i < key_count; i++) {
-        size_t new_len = keys_len + strlen(key_list[i]) + 2;
-        char* new_keys = realloc(keys, new_len);
-        if (!new_keys) {
-            report_error("Memory allocation failed", "generateSchemaKey", node->type);
-            for (int j = 0; j < key_count; j++) free(key_list[j]);
-            free(key_list);
-            free(keys);
-            return strdup("default");
+// Scalar arrays get one table per array name rather than per key set.
+int scalarArraySchema(SymbolTable* st, Slice name, Schema* schema, int* idBuf) {
+    int id = internSlice(&st->keys, name);
+    if (id < 0) return 0;
+    schema->kind = SCHEMA_SCALAR_ARRAY;
+    schema->keyIds = idBuf;
+    schema->keyIds[0] = id;
+    schema->keyCount = 1;
+    schema->hash = schemaSeed(SCHEMA_SCALAR_ARRAY) + mix64((uint64_t)id + 1);
+    return 1;
+}
+
+void freeSchema(Schema* schema, int* idBuf) {
+    if (schema->keyIds != idBuf) free(schema->keyIds);
+    schema->keyIds = idBuf;
+    schema->keyCount = 0;
+}
+
+// Called only when the hashes already match: every probe key must be in
+// the table's sorted key list.
+static int schemaMatches(const Schema* tableSchema, const Schema* probe) {
+    if (tableSchema->kind != probe->kind || tableSchema->keyCount != probe->keyCount) {
+        return 0;
+    }
+    for (int i = 0; i < probe->keyCount; i++) {
+        if (!bsearch(&probe->keyIds[i], tableSchema->keyIds, tableSchema->keyCount,
+                     sizeof(int), compareIds)) {
+            return 0;
         }
-        keys = new_keys;
-        if (keys_len > 0) {
-            strcat(keys, ",");
-            keys_len++;
+    }
+    return 1;
+}
+
+// Both indexes are open-addressing tables of registry index + 1 (0 marks
+// an empty slot), kept at most half full.
+static void indexInsert(int* slots, uint32_t mask, uint64_t hash, int index) {
+    uint32_t i = (uint32_t)hash & mask;
+    while (slots[i]) i = (i + 1) & mask;
+    slots[i] = index + 1;
+}
+
+static int rebuildIndexes(TableRegistry* reg, uint32_t slotCount) {
+    int* bySchema = calloc(slotCount, sizeof(int));
+    int* byName = calloc(slotCount, sizeof(int));
+    if (!bySchema || !byName) {
+        free(bySchema);
+        free(byName);
+        return 0;
+    }
+    for (int i = 0; i < reg->count; i++) {
+        indexInsert(bySchema, slotCount - 1, reg->tables[i]->schema.hash, i);
+        // Re-inserting in creation order keeps the first table of a name
+        // ahead of later ones in its probe sequence.
+        indexInsert(byName, slotCount - 1, hashBytes(reg->tables[i]->name, strlen(reg->tables[i]->name)), i);
+    }
+    free(reg->bySchema);
+    free(reg->byName);
+    reg->bySchema = bySchema;
+    reg->byName = byName;
+    reg->slotMask = slotCount - 1;
+    return 1;
+}
+
+static int growRegistry(TableRegistry* reg) {
+    if (reg->count == reg->cap) {
+        int cap = reg->cap ? reg->cap * 2 : 16;
+        Table** newTables = realloc(reg->tables, sizeof(Table*) * cap);
+        if (!newTables) return 0;
+        reg->tables = newTables;
+        reg->cap = cap;
+    }
+
+    if (reg->bySchema && (uint32_t)(reg->count + 1) * 2 <= reg->slotMask + 1) {
+        return 1;
+    }
+
+    return rebuildIndexes(reg, reg->bySchema ? (reg->slotMask + 1) * 2 : 64);
+}
+
+static Table* findTableBySchema(const TableRegistry* reg, const Schema* schema) {
+    if (!reg->bySchema) return NULL;
+    uint32_t i = (uint32_t)schema->hash & reg->slotMask;
+    while (reg->bySchema[i]) {
+        Table* t = reg->tables[reg->bySchema[i] - 1];
+        if (t->schema.hash == schema->hash && schemaMatches(&t->schema, schema)) {
+            return t;
         }
-        strcat(keys, key_list[i]);
-        keys_len = strlen(keys);
-        free(key_list[i]);
+        i = (i + 1) & reg->slotMask;
     }
-    free(key_list);
+    return NULL;
+}
 
-    if (!keys) {
-        return strdup("default");
+// Returns the first table created with this name.
+Table* findTableByName(const TableRegistry* reg, const char* name) {
+    if (!reg->byName || !name) return NULL;
+    uint32_t i = (uint32_t)hashBytes(name, strlen(name)) & reg->slotMask;
+    while (reg->byName[i]) {
+        Table* t = reg->tables[reg->byName[i] - 1];
+        if (strcmp(t->name, name) == 0) {
+            return t;
+        }
+        i = (i + 1) & reg->slotMask;
     }
-    return keys;
+    return NULL;
 }
 
-Table* findOrCreateTable(const char* schemaKey, const char* tableName, const char* parentName) {
-    if (!schemaKey) {
-        report_error("NULL schemaKey", "findOrCreateTable", NULL);
-        schemaKey = "default";
+Table* findOrCreateTable(SymbolTable* st, const Schema* schema, const char* tableName, const char* parentName) {
+    return findOrCreateTableAt(st, schema, tableName, parentName, st->registry.count);
+}
+
+// Like findOrCreateTable(), for callers that do not meet rows in the order
+// their tables would be created. serial is the row's position in that
+// order; the table takes its names from the row with the lowest serial,
+// and sortTablesBySerial() restores the creation order once all rows are
+// in. Names may change until then, so findTableByName() must not be used.
+Table* findOrCreateTableAt(SymbolTable* st, const Schema* schema, const char* tableName, const char* parentName, int serial) {
+    if (!schema) {
+        j2r_report_error("NULL schema", "findOrCreateTable", NULL);
+        return NULL;
     }
 
-    for (int i = 0; i < tableCount; i++) {
-        if (tables[i] && tables[i]->schemaKey && strcmp(tables[i]->schemaKey, schemaKey) == 0) {
-            return tables[i];
+    TableRegistry* reg = &st->registry;
+    Table* existing = findTableBySchema(reg, schema);
+    if (existing) {
+        if (serial < existing->serial) {
+            char* name = strdup(tableName ? tableName : "default");
+            char* parent = parentName ? strdup(parentName) : NULL;
+            if (!name || (parentName && !parent)) {
+                j2r_report_error("Memory allocation failed", "findOrCreateTable", NULL);
+                free(name);
+                free(parent);
+                return existing;
+            }
+            free(existing->name);
+            free(existing->parentName);
+            existing->name = name;
+            existing->parentName = parent;
+            existing->serial = serial;
         }
+        return existing;
     }
 
-    if (tableCount >= MAX_TABLES) {
-        report_error("Maximum table limit reached", "findOrCreateTable", NULL);
+    if (!growRegistry(reg)) {
+        j2r_report_error("Memory allocation failed", "findOrCreateTable", NULL);
         return NULL;
     }
 
     Table* table = malloc(sizeof(Table));
     if (!table) {
-        report_error("Memory allocation failed", "findOrCreateTable", NULL);
+        j2r_report_error("Memory allocation failed", "findOrCreateTable", NULL);
         return NULL;
     }
 
-    table->schemaKey = strdup(schemaKey);
-    table->name = strdup(tableName ? tableName : schemaKey);
+    table->schema = *schema;
+    table->schema.keyIds = malloc(sizeof(int) * (schema->keyCount ? schema->keyCount : 1));
+    if (table->schema.keyIds) {
+        memcpy(table->schema.keyIds, schema->keyIds, sizeof(int) * schema->keyCount);
+        qsort(table->schema.keyIds, schema->keyCount, sizeof(int), compareIds);
+    }
+    table->name = strdup(tableName ? tableName : "default");
     table->parentName = parentName ? strdup(parentName) : NULL;
-    table->rows = malloc(sizeof(Row*) * 10);
-    if (!table->schemaKey || !table->name || !table->rows || (parentName && !table->parentName)) {
-        report_error("Memory allocation failed", "findOrCreateTable", NULL);
-        free(table->schemaKey);
+    if (!table->schema.keyIds || !table->name || (parentName && !table->parentName)) {
+        j2r_report_error("Memory allocation failed", "findOrCreateTable", NULL);
+        free(table->schema.keyIds);
         free(table->name);
         free(table->parentName);
-        free(table->rows);
         free(table);
         return NULL;
     }
 
+    // Columns and row storage are allocated by the first addRow/setCell.
+    table->columns = NULL;
+    table->columnCount = 0;
+    table->columnCap = 0;
+    table->ids = NULL;
+    table->parentIds = NULL;
     table->rowCount = 0;
-    table->rowCap = 10;
-    tables[tableCount++] = table;
+    table->rowCap = 0;
+    table->serial = serial;
+    table->rowsSpilled = 0;
+    table->spill = NULL;
+    int index = reg->count++;
+    reg->tables[index] = table;
+    indexInsert(reg->bySchema, reg->slotMask, table->schema.hash, index);
+    indexInsert(reg->byName, reg->slotMask, hashBytes(table->name, strlen(table->name)), index);
     return table;
 }
 
-void addRow(Table* t, Row* row) {
-    if (!t || !row) {
-        report_error("NULL table or row", "addRow", NULL);
-        return;
+static size_t bitmapWords(int rows) {
+    return ((size_t)rows + 63) / 64;
+}
+
+// New rows start out null: their validity bits are cleared.
+static int growColumn(Column* c, int oldCap, int cap) {
+    CellData* cells = realloc(c->cells, sizeof(CellData) * cap);
+    if (!cells) return 0;
+    c->cells = cells;
+    if (c->types) {
+        uint8_t* types = realloc(c->types, cap);
+        if (!types) return 0;
+        c->types = types;
     }
+    uint64_t* valid = realloc(c->valid, sizeof(uint64_t) * bitmapWords(cap));
+    if (!valid) return 0;
+    memset(valid + bitmapWords(oldCap), 0,
+           sizeof(uint64_t) * (bitmapWords(cap) - bitmapWords(oldCap)));
+    c->valid = valid;
+    return 1;
+}
 
-    if (t->rowCount >= t->rowCap) {
-        t->rowCap *= 2;
-        Row** newRows = realloc(t->rows, sizeof(Row*) * t->rowCap);
-        if (!newRows) {
-            report_error("Memory allocation failed", "addRow", NULL);
-            return;
-        }
-        t->rows = newRows;
+static int compareSerials(const void* a, const void* b) {
+    const Table* x = *(Table* const*)a;
+    const Table* y = *(Table* const*)b;
+    return (x->serial > y->serial) - (x->serial < y->serial);
+}
+
+void sortTablesBySerial(SymbolTable* st) {
+    TableRegistry* reg = &st->registry;
+    if (reg->count == 0) return;
+    qsort(reg->tables, reg->count, sizeof(Table*), compareSerials);
+    if (!rebuildIndexes(reg, reg->slotMask + 1)) {
+        j2r_report_error("Memory allocation failed", "sortTablesBySerial", NULL);
     }
-    t->rows[t->rowCount++] = row;
 }
 
-void walkAST(ASTNode* node, const char* parentTable, int parentId) {
-    static int objectCount = 0;
-    if (!node || !node->type) {
-        report_error("NULL node or type", "walkAST", NULL);
-        return;
+// Grows every column together so that row r is slot r of each of them.
+static int growRows(Table* t) {
+    int cap = t->rowCap ? t->rowCap * 2 : 16;
+    int* ids = realloc(t->ids, sizeof(int) * cap);
+    if (!ids) return 0;
+    t->ids = ids;
+    int* parentIds = realloc(t->parentIds, sizeof(int) * cap);
+    if (!parentIds) return 0;
+    t->parentIds = parentIds;
+    for (int c = 0; c < t->columnCount; c++) {
+        if (!growColumn(&t->columns[c], t->rowCap, cap)) return 0;
+    }
+    t->rowCap = cap;
+    return 1;
+}
+
+// Appends a row with every cell empty and returns its index, or -1.
+int addRow(Table* t, int id, int parentId) {
+    if (!t) {
+        j2r_report_error("NULL table", "addRow", NULL);
+        return -1;
     }
 
-    printf("Debug: Processing node type=%s, parentTable=%s, parentId=%d\n",
-           node->type, parentTable ? parentTable : "none", parentId);
+    if (t->rowCount >= t->rowCap && !growRows(t)) {
+        j2r_report_error("Memory allocation failed", "addRow", NULL);
+        return -1;
+    }
+    t->ids[t->rowCount] = id;
+    t->parentIds[t->rowCount] = parentId;
+    return t->rowCount++;
+}
 
-    if (strcmp(node->type, "object") == 0) {
-        if (parentTable == NULL) {
-            objectCount++;
-            printf("Debug: Processing top-level object #%d\n", objectCount);
-            if (objectCount > 1) {
-                fprintf(stderr, "Warning: Multiple top-level objects detected\n");
-            }
+// Rows normally list their keys in the same order as the table's first
+// row, so the column at hint is tried before scanning.
+static int findColumn(const Table* t, int keyId, int hint) {
+    if (hint >= 0 && hint < t->columnCount && t->columns[hint].keyId == keyId) {
+        return hint;
+    }
+    for (int c = 0; c < t->columnCount; c++) {
+        if (t->columns[c].keyId == keyId) return c;
+    }
+    return -1;
+}
+
+// A key the table has not seen yet (e.g. "seq" on rows that came from an
+// array) becomes a new column, null for all earlier rows.
+static int addColumn(Table* t, int keyId) {
+    if (t->columnCount == t->columnCap) {
+        int cap = t->columnCap ? t->columnCap * 2 : 8;
+        Column* columns = realloc(t->columns, sizeof(Column) * cap);
+        if (!columns) return -1;
+        t->columns = columns;
+        t->columnCap = cap;
+    }
+    Column* c = &t->columns[t->columnCount];
+    memset(c, 0, sizeof(Column));
+    c->keyId = keyId;
+    c->type = VALUE_NULL;
+    c->firstRow = t->rowCount - 1;
+    if (!growColumn(c, 0, t->rowCap ? t->rowCap : 1)) {
+        free(c->cells);
+        free(c->valid);
+        return -1;
+    }
+    return t->columnCount++;
+}
+
+static void freeCell(Column* c, int row) {
+    Value old = columnValue(c, row);
+    if (valueHasText(old.type)) sliceFree(&old.as.s);
+    c->valid[row >> 6] &= ~(1ULL << (row & 63));
+}
+
+// A column keeps a single type while all its values agree and only pays
+// for a per-cell type byte once they do not.
+static int storeType(Column* c, int capacity, ValueType type) {
+    if (c->types) return 1;
+    if (c->type == VALUE_NULL) {
+        c->type = type;
+        return 1;
+    }
+    if (c->type == type) return 1;
+    c->types = malloc(capacity);
+    if (!c->types) return 0;
+    memset(c->types, c->type, capacity);
+    return 1;
+}
+
+// Stores value in the given row. The table takes ownership of value,
+// including on failure; decoded strings are copied, as they only live as
+// long as their lexer.
+int setCell(Table* t, int row, int keyId, Value value, int hint) {
+    if (valueHasText(value.type) && (value.as.s.flags & SLICE_TRANSIENT)) {
+        char* copy = sliceDup(value.as.s);
+        if (!copy) {
+            j2r_report_error("Memory allocation failed", "setCell", NULL);
+            return 0;
         }
+        value.as.s.ptr = copy;
+        value.as.s.flags = SLICE_OWNED;
+    }
+    int c = findColumn(t, keyId, hint);
+    if (c < 0) c = addColumn(t, keyId);
+    if (c < 0 || (value.type != VALUE_NULL && !storeType(&t->columns[c], t->rowCap, value.type))) {
+        j2r_report_error("Memory allocation failed", "setCell", NULL);
+        if (valueHasText(value.type)) sliceFree(&value.as.s);
+        return 0;
+    }
 
-        ASTNode* members = NULL;
-        for (int i = 0; i < node->childCount; i++) {
-            if (node->children[i] && strcmp(node->children[i]->type, "members") == 0) {
-                members = node->children[i];
-                break;
-            }
+    Column* col = &t->columns[c];
+    freeCell(col, row);
+    if (value.type == VALUE_NULL) return 1;
+    col->cells[row] = value.as;
+    if (col->types) col->types[row] = (uint8_t)value.type;
+    col->valid[row >> 6] |= 1ULL << (row & 63);
+    return 1;
+}
+
+// Text form of a value, as written to CSV. Strings and numbers are
+// returned as they are; other types are formatted into buf.
+Slice valueText(const Value* v, char* buf, size_t cap) {
+    switch (v->type) {
+        case VALUE_STRING:
+        case VALUE_NUMBER:
+            return v->as.s;
+        case VALUE_INT:
+            snprintf(buf, cap, "%lld", (long long)v->as.i);
+            return sliceOf(buf);
+        case VALUE_DOUBLE:
+            numberFormat(v->as.d, buf, cap);
+            return sliceOf(buf);
+        case VALUE_BOOL:
+            return sliceOf(v->as.b ? "true" : "false");
+        default:
+            return sliceOf("");
+    }
+}
+
+// Strings and numbers point into the input buffer; bools are stored
+// natively and only turned into text by the writer. Containers that are
+// not walked (empty objects, arrays inside scalar arrays) count as
+// placeholders.
+static Value scalarValue(ASTNode* valNode) {
+    Value v;
+    if (valNode->kind == NODE_NUMBER) {
+        v.type = VALUE_NUMBER;
+        v.as.s = valNode->strVal;
+    } else if (valNode->strVal.ptr) {
+        v.type = VALUE_STRING;
+        v.as.s = valNode->strVal;
+    } else if (valNode->kind == NODE_BOOL) {
+        v.type = VALUE_BOOL;
+        v.as.b = valNode->boolVal;
+    } else if (valNode->kind == NODE_NULL) {
+        v.type = VALUE_NULL;
+    } else {
+        v = placeholderValue();
+    }
+    return v;
+}
+
+static ASTNode* findMembers(ASTNode* node) {
+    for (int i = 0; i < node->childCount; i++) {
+        if (node->children[i] && node->children[i]->kind == NODE_MEMBERS) {
+            return node->children[i];
         }
+    }
+    return NULL;
+}
+
+// Appends the row of one object, values[k] being the value of keyIds[k].
+// A seq >= 0 is the object's position in its array and is stored as a
+// leading "seq" column. The values move to the table and are reset to null.
+void addObjectRow(SymbolTable* st, Table* table, int id, int parentId, int seq,
+                  const int* keyIds, Value* values, int keyCount) {
+    int row = addRow(table, id, parentId);
+    if (row < 0) return;
+    int offset = seq >= 0 ? 1 : 0;
+    if (seq >= 0) {
+        int seqId = internSlice(&st->keys, sliceOf("seq"));
+        if (seqId >= 0) setCell(table, row, seqId, intValue(seq), 0);
+    }
+    for (int k = 0; k < keyCount; k++) {
+        setCell(table, row, keyIds[k], values[k], k + offset);
+        values[k] = nullValue();
+    }
+}
+
+// Turns one object into a row of tableName. Nested objects and arrays are
+// walked while the values are collected, so their rows come before this
+// one, which is appended only at the end.
+static void walkRow(SymbolTable* st, ASTNode* node, const char* tableName, const char* parentName,
+                    int parentId, int seq) {
+    ASTNode* members = findMembers(node);
+    if (!members) {
+        logDebug("No members node found for object");
+        return;
+    }
 
-        if (!members) {
-            printf("Debug: No members node found for object\n");
+    int idBuf[SCHEMA_INLINE_KEYS];
+    Schema schema;
+    if (!generateSchema(st, node, &schema, idBuf, SCHEMA_INLINE_KEYS)) {
+        j2r_report_error("Failed to generate schema", "walkAST", nodeKindName(node->kind));
+        return;
+    }
+
+    Table* table = findOrCreateTable(st, &schema, tableName, parentName);
+    if (!table) {
+        j2r_report_error("Failed to create table", "walkAST", nodeKindName(node->kind));
+        freeSchema(&schema, idBuf);
+        return;
+    }
+
+    // values[k] belongs to schema.keyIds[k]: both skip pairs without a key.
+    Value valBuf[SCHEMA_INLINE_KEYS];
+    Value* values = valBuf;
+    if (schema.keyCount > SCHEMA_INLINE_KEYS) {
+        values = malloc(sizeof(Value) * schema.keyCount);
+        if (!values) {
+            j2r_report_error("Memory allocation failed for values", "walkAST", nodeKindName(node->kind));
+            freeSchema(&schema, idBuf);
             return;
         }
+    }
 
-        char* schemaKey = generateSchemaKey(node);
-        if (!schemaKey) {
-            report_error("Failed to generate schema key", "walkAST", node->type);
-            return;
+    int id = st->idCounter++;
+    int keyCount = 0;
+    int filled = 0;
+    for (int i = 0; i < members->childCount; i++) {
+        ASTNode* child = members->children[i];
+        if (!child || child->kind != NODE_PAIR) {
+            logDebug("Skipping non-pair child at index %d, type=%s",
+                     i, child ? nodeKindName(child->kind) : "null");
+            continue;
+        }
+        if (!child->strVal.ptr) {
+            j2r_report_error("Invalid pair node (missing strVal or child)", "walkAST", nodeKindName(child->kind));
+            continue;
         }
 
-        char* tableName = parentTable ? strdup(parentTable) : strdup("objects");
-        if (!tableName) {
-            report_error("Memory allocation failed for table name", "walkAST", node->type);
-            free(schemaKey);
-            return;
+        Value* value = &values[keyCount++];
+        *value = nullValue();
+        ASTNode* valNode = child->childCount == 1 ? child->children[0] : NULL;
+        if (!valNode) {
+            j2r_report_error("Invalid pair node (missing strVal or child)", "walkAST", nodeKindName(child->kind));
+            continue;
         }
 
-        Table* table = findOrCreateTable(schemaKey, tableName, parentTable);
-        if (!table) {
-            report_error("Failed to create table", "walkAST", node->type);
-            free(schemaKey);
-            free(tableName);
-            return;
+        logTrace("Processing pair key=%.*s, value type=%s",
+                 (int)child->strVal.len, child->strVal.ptr, nodeKindName(valNode->kind));
+
+        if (valNode->kind == NODE_OBJECT || valNode->kind == NODE_ARRAY) {
+            *value = placeholderValue();
+            walkAST(st, valNode, &child->strVal, id);
+        } else {
+            *value = scalarValue(valNode);
         }
+        filled++;
+    }
 
-        Row* row = malloc(sizeof(Row));
-        if (!row) {
-            report_error("Memory allocation failed for row", "walkAST", node->type);
-            free(schemaKey);
-            free(tableName);
-            return;
+    if (filled == 0) {
+        logDebug("No key-value pairs added to row ID %d in table %s", id, table->name);
+    } else {
+        addObjectRow(st, table, id, parentId, seq, schema.keyIds, values, keyCount);
+    }
+
+    for (int k = 0; k < keyCount; k++) {
+        if (valueHasText(values[k].type)) sliceFree(&values[k].as.s);
+    }
+    if (values != valBuf) free(values);
+    freeSchema(&schema, idBuf);
+}
+
+static void walkObject(SymbolTable* st, ASTNode* node, const Slice* parentTable, int parentId) {
+    if (parentTable == NULL) {
+        st->topLevelObjects++;
+        logDebug("Processing top-level object #%d", st->topLevelObjects);
+        if (st->topLevelObjects > 1) {
+            logWarn("Multiple top-level objects detected");
         }
+    }
 
-        row->id = idCounter++;
-        row->parentId = parentId;
-        row->tableName = strdup(table->name);
-        row->keyCount = 0;
-        row->keys = NULL;
-        row->values = NULL;
+    char* tableName = parentTable ? sliceDup(*parentTable) : strdup("objects");
+    if (!tableName) {
+        j2r_report_error("Memory allocation failed for table name", "walkAST", nodeKindName(node->kind));
+        return;
+    }
+    walkRow(st, node, tableName, parentTable ? tableName : NULL, parentId, -1);
+    free(tableName);
+}
 
-        for (int i = 0; i < members->childCount; i++) {
-            ASTNode* child = members->children[i];
-            if (!child || strcmp(child->type, "pair") != 0) {
-                printf("Debug: Skipping non-pair child at index %d, type=%s\n",
-                       i, child ? child->type : "null");
-                continue;
-            }
+// A top-level array holds records: each object in it is converted as if
+// it were a top-level object of its own.
+static void walkRecord(SymbolTable* st, ASTNode* node) {
+    if (!node) {
+        j2r_report_error("NULL node", "walkAST", NULL);
+    } else if (node->kind == NODE_OBJECT) {
+        walkRow(st, node, "objects", NULL, 0, -1);
+    } else if (node->kind == NODE_ARRAY) {
+        j2r_report_error("NULL parentTable for array", "walkAST", nodeKindName(node->kind));
+    } else {
+        logDebug("Skipping node type=%s", nodeKindName(node->kind));
+    }
+}
 
-            if (!child->strVal || child->childCount != 1) {
-                report_error("Invalid pair node (missing strVal or child)", "walkAST", child->type);
-                continue;
-            }
+#define RECORDS_PER_CHUNK_MIN 256
 
-            ASTNode* valNode = child->children[0];
-            if (!valNode) {
-                report_error("NULL value node in pair", "walkAST", child->type);
-                continue;
-            }
+typedef struct {
+    ASTNode* array;
+    int first;          // First element of the chunk
+    int last;           // One past its last element
+    SymbolTable symbols;
+} RecordChunk;
 
-            printf("Debug: Processing pair key=%s, value type=%s\n",
-                   child->strVal, valNode->type);
-
-            row->keys = realloc(row->keys, sizeof(char*) * (row->keyCount + 1));
-            row->values = realloc(row->values, sizeof(char*) * (row->keyCount + 1));
-            if (!row->keys || !row->values) {
-                report_error("Memory allocation failed for keys/values", "walkAST", node->type);
-                free(row->keys);
-                free(row->values);
-                free(row->tableName);
-                free(row);
-                free(schemaKey);
-                free(tableName);
-                return;
-            }
+static void walkRecordChunk(void* ctx, int index) {
+    RecordChunk* c = &((RecordChunk*)ctx)[index];
+    for (int i = c->first; i < c->last; i++) {
+        walkRecord(&c->symbols, c->array->children[i]);
+    }
+}
 
-            row->keys[row->keyCount] = strdup(child->strVal);
-            if (!row->keys[row->keyCount]) {
-                report_error("Memory allocation failed for key", "walkAST", node->type);
-                free(row->keys);
-                free(row->values);
-                free(row->tableName);
-                free(row);
-                free(schemaKey);
-                free(tableName);
-                return;
-            }
+// Chunks of records are walked on worker threads into tables of their own
+// and merged in array order. Each chunk numbers its rows from 1 and the
+// merge shifts them by the row count of the chunks before it, so the
+// result is the same as walking the records one by one. The chunks start
+// with a copy of st's keys, so the ids the lexer gave the pairs hold in
+// every chunk.
+static void walkRecords(SymbolTable* st, ASTNode* node, int jobs) {
+    int chunkCount = jobs * 4;
+    if (chunkCount > node->childCount / RECORDS_PER_CHUNK_MIN) {
+        chunkCount = node->childCount / RECORDS_PER_CHUNK_MIN;
+    }
+    RecordChunk* chunks = jobs > 1 && chunkCount > 1 ? calloc(chunkCount, sizeof(RecordChunk)) : NULL;
+    for (int k = 0; chunks && k < chunkCount; k++) {
+        initSymbolTable(&chunks[k].symbols);
+        if (!internClone(&chunks[k].symbols.keys, &st->keys)) {
+            for (int j = 0; j < k; j++) freeSymbolTables(&chunks[j].symbols);
+            free(chunks);
+            chunks = NULL;
+        }
+    }
+    if (!chunks) {
+        for (int i = 0; i < node->childCount; i++) {
+            walkRecord(st, node->children[i]);
+        }
+        return;
+    }
 
-            if (strcmp(valNode->type, "object") == 0 || strcmp(valNode->type, "array") == 0) {
-                row->values[row->keyCount] = strdup("");
-                walkAST(valNode, child->strVal, row->id);
-            } else {
-                if (valNode->strVal) {
-                    row->values[row->keyCount] = strdup(valNode->strVal);
-                } else if (valNode->hasInt) {
-                    char buffer[32];
-                    snprintf(buffer, sizeof(buffer), "%d", valNode->intVal);
-                    row->values[row->keyCount] = strdup(buffer);
-                } else if (valNode->hasBool) {
-                    row->values[row->keyCount] = strdup(valNode->boolVal ? "true" : "false");
-                } else {
-                    row->values[row->keyCount] = strdup("");
-                }
-            }
+    logDebug("Walking %d records in %d chunks", node->childCount, chunkCount);
+    for (int k = 0; k < chunkCount; k++) {
+        chunks[k].array = node;
+        chunks[k].first = (int)((long)node->childCount * k / chunkCount);
+        chunks[k].last = (int)((long)node->childCount * (k + 1) / chunkCount);
+    }
+    parallelFor(chunkCount, jobs, walkRecordChunk, chunks);
+    for (int k = 0; k < chunkCount; k++) {
+        mergeSymbolTable(st, &chunks[k].symbols);
+    }
+    free(chunks);
+}
 
-            if (!row->values[row->keyCount]) {
-                report_error("Memory allocation failed for value", "walkAST", node->type);
-                free(row->keys[row->keyCount]);
-                free(row->keys);
-                free(row->values);
-                free(row->tableName);
-                free(row);
-                free(schemaKey);
-                free(tableName);
-                return;
-            }
+static void walkArray(SymbolTable* st, ASTNode* node, const Slice* parentTable, int parentId) {
+    if (!parentTable) {
+        walkRecords(st, node, 1);
+        return;
+    }
 
-            row->keyCount++;
+    int isObjectArray = 0;
+    for (int i = 0; i < node->childCount; i++) {
+        if (node->children[i] && node->children[i]->kind == NODE_OBJECT) {
+            isObjectArray = 1;
+            break;
         }
+    }
 
-        if (row->keyCount == 0) {
-            printf("Debug: No key-value pairs added to row ID %d in table %s\n",
-                   row->id, table->name);
-            free(row->keys);
-            free(row->values);
-            free(row->tableName);
-            free(row);
-        } else {
-            addRow(table, row);
+    logTrace("Processing array, isObjectArray=%d, childCount=%d",
+             isObjectArray, node->childCount);
+
+    char* parentName = sliceDup(*parentTable);
+    if (!parentName) {
+        j2r_report_error("Memory allocation failed for table name", "walkAST", nodeKindName(node->kind));
+        return;
+    }
+
+    if (isObjectArray) {
+        for (int i = 0; i < node->childCount; i++) {
+            ASTNode* child = node->children[i];
+            if (!child || child->kind != NODE_OBJECT) {
+                logDebug("Skipping non-object child at index %d, type=%s",
+                         i, child ? nodeKindName(child->kind) : "null");
+                continue;
+            }
+            walkRow(st, child, parentName, parentName, parentId, i);
         }
-        free(schemaKey);
-        free(tableName);
-    } else if (strcmp(node->type, "array") == 0) {
-        if (!parentTable) {
-            report_error("NULL parentTable for array", "walkAST", node->type);
+    } else {
+        Table* namesake = findTableByName(&st->registry, parentName);
+        const char* grandparentName = namesake ? namesake->parentName : NULL;
+        int idBuf[1];
+        Schema schema;
+        Table* table = NULL;
+        if (scalarArraySchema(st, *parentTable, &schema, idBuf)) {
+            table = findOrCreateTable(st, &schema, parentName, grandparentName ? grandparentName : "objects");
+        }
+        int indexId = internSlice(&st->keys, sliceOf("index"));
+        int valueId = internSlice(&st->keys, sliceOf("value"));
+        if (!table || indexId < 0 || valueId < 0) {
+            free(parentName);
             return;
         }
 
-        int isObjectArray = 0;
         for (int i = 0; i < node->childCount; i++) {
-            if (node->children[i] && strcmp(node->children[i]->type, "object") == 0) {
-                isObjectArray = 1;
-                break;
+            ASTNode* child = node->children[i];
+            if (!child) {
+                logDebug("Skipping NULL child at index %d in array", i);
+                continue;
             }
-        }
 
-        printf("Debug: Processing array, isObjectArray=%d, childCount=%d\n",
-               isObjectArray, node->childCount);
-
-        if (isObjectArray) {
-            for (int i = 0; i < node->childCount; i++) {
-                ASTNode* child = node->children[i];
-                if (!child || strcmp(child->type, "object") != 0) {
-                    printf("Debug: Skipping non-object child at index %d, type=%s\n",
-                           i, child ? child->type : "null");
-                    continue;
-                }
-
-                char* schemaKey = generateSchemaKey(child);
-                Table* table = findOrCreateTable(schemaKey, parentTable, parentTable);
-                if (!table) {
-                    free(schemaKey);
-                    continue;
-                }
-
-                Row* row = malloc(sizeof(Row));
-                if (!row) {
-                    free(schemaKey);
-                    continue;
-                }
-
-                row->id = idCounter++;
-                row->parentId = parentId;
-                row->tableName = strdup(table->name);
-                row->keyCount = 0;
-                row->keys = NULL;
-                row->values = NULL;
-
-                row->keys = realloc(row->keys, sizeof(char*) * (row->keyCount + 1));
-                row->values = realloc(row->values, sizeof(char*) * (row->keyCount + 1));
-                if (!row->keys || !row->values) {
-                    free(row->keys);
-                    free(row->values);
-                    free(row->tableName);
-                    free(row);
-                    free(schemaKey);
-                    continue;
-                }
-                row->keys[row->keyCount] = strdup("seq");
-                char seq_buffer[32];
-                snprintf(seq_buffer, sizeof(seq_buffer), "%d", i);
-                row->values[row->keyCount] = strdup(seq_buffer);
-                if (!row->keys[row->keyCount] || !row->values[row->keyCount]) {
-                    free(row->keys[row->keyCount]);
-                    free(row->values[row->keyCount]);
-                    free(row->keys);
-                    free(row->values);
-                    free(row->tableName);
-                    free(row);
-                    free(schemaKey);
-                    continue;
-                }
-                row->keyCount++;
-
-                for (int j = 0; j < child->childCount; j++) {
-                    ASTNode* pair = child->children[j];
-                    if (!pair || strcmp(pair->type, "pair") != 0 || !pair->strVal || pair->childCount != 1) {
-                        printf("Debug: Skipping invalid pair at index %d, type=%s\n",
-                               j, pair ? pair->type : "null");
-                        continue;
-                    }
-
-                    ASTNode* valNode = pair->children[0];
-                    row->keys = realloc(row->keys, sizeof(char*) * (row->keyCount + 1));
-                    row->values = realloc(row->values, sizeof(char*) * (row->keyCount + 1));
-                    if (!row->keys || !row->values) {
-                        free(row->keys);
-                        free(row->values);
-                        free(row->tableName);
-                        free(row);
-                        free(schemaKey);
-                        continue;
-                    }
-                    row->keys[row->keyCount] = strdup(pair->strVal);
-                    if (strcmp(valNode->type, "object") == 0 || strcmp(valNode->type, "array") == 0) {
-                        row->values[row->keyCount] = strdup("");
-                        walkAST(valNode, pair->strVal, row->id);
-                    } else {
-                        if (valNode->strVal) {
-                            row->values[row->keyCount] = strdup(valNode->strVal);
-                        } else if (valNode->hasInt) {
-                            char buffer[32];
-                            snprintf(buffer, sizeof(buffer), "%d", valNode->intVal);
-                            row->values[row->keyCount] = strdup(buffer);
-                        } else if (valNode->hasBool) {
-                            row->values[row->keyCount] = strdup(valNode->boolVal ? "true" : "false");
-                        } else {
-                            row->values[row->keyCount] = strdup("");
-                        }
-                    }
-                    if (!row->keys[row->keyCount] || !row->values[row->keyCount]) {
-                        free(row->keys[row->keyCount]);
-                        free(row->values[row->keyCount]);
-                        free(row->keys);
-                        free(row->values);
-                        free(row->tableName);
-                        free(row);
-                        free(schemaKey);
-                        continue;
-                    }
-                    row->keyCount++;
-                }
-
-                if (row->keyCount == 1) {
-                    printf("Debug: No fields added to array object row ID %d in table %s\n",
-                           row->id, table->name);
-                    free(row->keys[0]);
-                    free(row->values[0]);
-                    free(row->keys);
-                    free(row->values);
-                    free(row->tableName);
-                    free(row);
-                } else {
-                    addRow(table, row);
-                }
-                free(schemaKey);
-            }
-        } else {
-            char* schemaKey = strdup(parentTable);
-            const char* grandparentName = NULL;
-            for (int i = 0; i < tableCount; i++) {
-                if (tables[i] && tables[i]->name && strcmp(tables[i]->name, parentTable) == 0) {
-                    grandparentName = tables[i]->parentName;
-                    break;
-                }
-            }
-            Table* table = findOrCreateTable(schemaKey, parentTable, grandparentName ? grandparentName : "objects");
-            if (!table) {
-                free(schemaKey);
-                return;
-            }
+            logTrace("Processing scalar array element at index %d, type=%s",
+                     i, nodeKindName(child->kind));
 
-            for (int i = 0; i < node->childCount; i++) {
-                ASTNode* child = node->children[i];
-                if (!child) {
-                    printf("Debug: Skipping NULL child at index %d in array\n", i);
-                    continue;
-                }
-
-                printf("Debug: Processing scalar array element at index %d, type=%s\n",
-                       i, child->type);
-
-                Row* row = malloc(sizeof(Row));
-                if (!row) continue;
-
-                row->id = idCounter++;
-                row->parentId = parentId;
-                row->tableName = strdup(table->name);
-                row->keyCount = 2;
-                row->keys = malloc(sizeof(char*) * 2);
-                row->values = malloc(sizeof(char*) * 2);
-                if (!row->tableName || !row->keys || !row->values) {
-                    free(row->tableName);
-                    free(row->keys);
-                    free(row->values);
-                    free(row);
-                    continue;
-                }
-
-                row->keys[0] = strdup("index");
-                char index_buffer[32];
-                snprintf(index_buffer, sizeof(index_buffer), "%d", i);
-                row->values[0] = strdup(index_buffer);
-
-                row->keys[1] = strdup("value");
-                if (child->strVal) {
-                    row->values[1] = strdup(child->strVal);
-                } else if (child->hasInt) {
-                    char buffer[32];
-                    snprintf(buffer, sizeof(buffer), "%d", child->intVal);
-                    row->values[1] = strdup(buffer);
-                } else if (child->hasBool) {
-                    row->values[1] = strdup(child->boolVal ? "true" : "false");
-                } else {
-                    row->values[1] = strdup("");
-                }
-
-                if (!row->keys[0] || !row->values[0] || !row->keys[1] || !row->values[1]) {
-                    free(row->keys[0]);
-                    free(row->values[0]);
-                    free(row->keys[1]);
-                    free(row->values[1]);
-                    free(row->keys);
-                    free(row->values);
-                    free(row->tableName);
-                    free(row);
-                    continue;
-                }
-
-                addRow(table, row);
-            }
-            free(schemaKey);
+            int row = addRow(table, st->idCounter++, parentId);
+            if (row < 0) continue;
+            setCell(table, row, indexId, intValue(i), 0);
+            setCell(table, row, valueId, scalarValue(child), 1);
         }
+    }
+    free(parentName);
+}
+
+void walkAST(SymbolTable* st, ASTNode* node, const Slice* parentTable, int parentId) {
+    if (!node) {
+        j2r_report_error("NULL node", "walkAST", NULL);
+        return;
+    }
+
+    logTrace("Processing node type=%s, parentTable=%.*s, parentId=%d",
+             nodeKindName(node->kind), parentTable ? (int)parentTable->len : 4,
+             parentTable ? parentTable->ptr : "none", parentId);
+
+    switch (node->kind) {
+        case NODE_OBJECT:
+            walkObject(st, node, parentTable, parentId);
+            break;
+        case NODE_ARRAY:
+            walkArray(st, node, parentTable, parentId);
+            break;
+        default:
+            logDebug("Skipping node type=%s", nodeKindName(node->kind));
+            break;
+    }
+}
+
+// Walks a document root. The records of a top-level array are walked on
+// up to jobs threads; callers already running on a pool pass 1.
+void walkDocument(SymbolTable* st, ASTNode* root, int jobs) {
+    if (root && root->kind == NODE_ARRAY) {
+        walkRecords(st, root, jobs);
     } else {
-        printf("Debug: Skipping node type=%s\n", node->type);
+        walkAST(st, root, NULL, 0);
     }
 }
 
-void printSymbolTables() {
-    if (tableCount == 0) {
+void printSymbolTables(const SymbolTable* st) {
+    const TableRegistry* reg = &st->registry;
+    if (reg->count == 0) {
         printf("No tables to print.\n");
         return;
     }
-    for (int i = 0; i < tableCount; i++) {
-        Table* table = tables[i];
+    for (int i = 0; i < reg->count; i++) {
+        Table* table = reg->tables[i];
         if (!table) continue;
         printf("Table: %s (Parent: %s)\n", table->name, table->parentName ? table->parentName : "none");
         for (int j = 0; j < table->rowCount; j++) {
-            Row* row = table->rows[j];
-            if (!row) continue;
-            printf("  Row %d (Parent ID: %d):\n", row->id, row->parentId);
-            for (int k = 0; k < row->keyCount; k++) {
-                printf("    Key: %s, Value: %s\n",
-                       row->keys[k] ? row->keys[k] : "null",
-                       row->values[k] ? row->values[k] : "null");
-            }
-            if (row->keyCount == 0) {
-                printf("    (No key-value pairs)\n");
+            printf("  Row %d (Parent ID: %d):\n", table->ids[j], table->parentIds[j]);
+            for (int c = 0; c < table->columnCount; c++) {
+                Slice key = internedSlice(&st->keys, table->columns[c].keyId);
+                Value value = columnValue(&table->columns[c], j);
+                char buffer[32];
+                Slice text = valueText(&value, buffer, sizeof(buffer));
+                printf("    Key: %.*s, Value: %.*s\n",
+                       (int)key.len, key.ptr, (int)text.len, text.ptr);
             }
         }
         printf("\n");
     }
 }
 
-void freeSymbolTables() {
-    for (int i = 0; i < tableCount; i++) {
-        Table* table = tables[i];
-        if (!table) continue;
-        for (int j = 0; j < table->rowCount; j++) {
-            Row* row = table->rows[j];
-            if (!row) continue;
-            for (int k = 0; k < row->keyCount; k++) {
-                free(row->keys[k]);
-                free(row->values[k]);
+static void freeColumn(Column* c, int rowCount) {
+    for (int j = 0; j < rowCount; j++) {
+        freeCell(c, j);
+    }
+    free(c->cells);
+    free(c->types);
+    free(c->valid);
+}
+
+static void freeTable(Table* table) {
+    for (int c = 0; c < table->columnCount; c++) {
+        freeColumn(&table->columns[c], table->rowCount);
+    }
+    free(table->columns);
+    free(table->ids);
+    free(table->parentIds);
+    free(table->schema.keyIds);
+    free(table->name);
+    free(table->parentName);
+    free(table);
+}
+
+// Undoes a document that failed halfway: drops the rows with ids from
+// firstId on, the columns only those rows had, and the tables created
+// after the first tableCount.
+void discardRowsFrom(SymbolTable* st, int firstId, int tableCount) {
+    TableRegistry* reg = &st->registry;
+    for (int i = 0; i < reg->count; i++) {
+        Table* t = reg->tables[i];
+        while (t->rowCount > 0 && t->ids[t->rowCount - 1] >= firstId) {
+            t->rowCount--;
+            for (int c = 0; c < t->columnCount; c++) {
+                freeCell(&t->columns[c], t->rowCount);
             }
-            free(row->keys);
-            free(row->values);
-            free(row->tableName);
-            free(row);
         }
-        free(table->rows);
-        free(table->schemaKey);
-        free(table->name);
-        free(table->parentName);
-        free(table);
+        while (t->columnCount > 0 && t->columns[t->columnCount - 1].firstRow >= t->rowCount) {
+            t->columnCount--;
+            freeColumn(&t->columns[t->columnCount], 0);
+        }
+    }
+    if (reg->count > tableCount) {
+        while (reg->count > tableCount) {
+            freeTable(reg->tables[--reg->count]);
+        }
+        if (!rebuildIndexes(reg, reg->slotMask + 1)) {
+            j2r_report_error("Memory allocation failed", "discardRowsFrom", NULL);
+        }
+    }
+    st->idCounter = firstId;
+}
+
+// Drops the rows of one table but keeps its columns and row storage.
+void clearTableRows(Table* t) {
+    for (int c = 0; c < t->columnCount; c++) {
+        for (int j = 0; j < t->rowCount; j++) {
+            freeCell(&t->columns[c], j);
+        }
+        t->columns[c].firstRow = -1;
     }
-    tableCount = 0;
-    idCounter = 1;
-}
\ No newline at end of file
+    t->rowCount = 0;
+}
+
+// Drops every row but keeps the tables, their columns and the id counter,
+// for callers that hand rows off as they are converted.
+void clearRows(SymbolTable* st) {
+    for (int i = 0; i < st->registry.count; i++) {
+        clearTableRows(st->registry.tables[i]);
+    }
+}
+
+// Merges one table of src into dst. Key ids are translated with keyMap;
+// cell values change owner, so src must be freed without them.
+static int mergeTable(SymbolTable* dst, Table* t, const int* keyMap, int idOffset) {
+    int inlineIds[SCHEMA_INLINE_KEYS];
+    int* keyIds = inlineIds;
+    if (t->schema.keyCount > SCHEMA_INLINE_KEYS) {
+        keyIds = malloc(sizeof(int) * t->schema.keyCount);
+        if (!keyIds) return 0;
+    }
+    Schema schema;
+    if (t->schema.kind == SCHEMA_SCALAR_ARRAY) {
+        int id = keyMap[t->schema.keyIds[0]];
+        keyIds[0] = id;
+        schema.kind = SCHEMA_SCALAR_ARRAY;
+        schema.keyIds = keyIds;
+        schema.keyCount = 1;
+        schema.hash = schemaSeed(SCHEMA_SCALAR_ARRAY) + mix64((uint64_t)id + 1);
+    } else {
+        for (int k = 0; k < t->schema.keyCount; k++) {
+            keyIds[k] = keyMap[t->schema.keyIds[k]];
+        }
+        objectSchema(keyIds, t->schema.keyCount, &schema);
+    }
+    // A new scalar-array table takes its parent name from the first dst
+    // table of the same name, as walkArray() does, since src did not have
+    // the tables before it to look at.
+    const char* parentName = t->parentName;
+    if (t->schema.kind == SCHEMA_SCALAR_ARRAY) {
+        Table* namesake = findTableByName(&dst->registry, t->name);
+        parentName = namesake && namesake->parentName ? namesake->parentName : "objects";
+    }
+    Table* target = findOrCreateTableAt(dst, &schema, t->name, parentName, dst->serialCounter);
+    if (keyIds != inlineIds) free(keyIds);
+    if (!target) return 0;
+    if (target->serial == dst->serialCounter) dst->serialCounter++;
+
+    // Columns new to dst follow the existing ones in src order, which is
+    // where a single pass over the same records would have put them.
+    int* columnMap = malloc(sizeof(int) * (t->columnCount ? t->columnCount : 1));
+    if (!columnMap) return 0;
+    int firstRow = target->rowCount;
+    for (int c = 0; c < t->columnCount; c++) {
+        int keyId = keyMap[t->columns[c].keyId];
+        columnMap[c] = findColumn(target, keyId, c);
+        if (columnMap[c] < 0) {
+            columnMap[c] = addColumn(target, keyId);
+            if (columnMap[c] < 0) {
+                free(columnMap);
+                return 0;
+            }
+            target->columns[columnMap[c]].firstRow = firstRow;
+        }
+    }
+
+    int ok = 1;
+    for (int j = 0; j < t->rowCount && ok; j++) {
+        int parentId = t->parentIds[j] ? t->parentIds[j] + idOffset : 0;
+        int row = addRow(target, t->ids[j] + idOffset, parentId);
+        if (row < 0) {
+            ok = 0;
+            break;
+        }
+        for (int c = 0; c < t->columnCount; c++) {
+            Column* col = &t->columns[c];
+            Value value = columnValue(col, j);
+            if (value.type == VALUE_NULL) continue;
+            col->valid[j >> 6] &= ~(1ULL << (j & 63));
+            if (!setCell(target, row, target->columns[columnMap[c]].keyId, value, columnMap[c])) {
+                ok = 0;
+                break;
+            }
+        }
+    }
+    free(columnMap);
+    return ok;
+}
+
+// Appends everything in src to dst, as if src's documents had been
+// converted into dst after the ones already there: src's row ids (which
+// start at 1) are shifted past dst's and its tables are matched to dst's
+// by schema. src must be sorted by serial (tables built by walkAST() are
+// already); it is freed either way.
+int mergeSymbolTable(SymbolTable* dst, SymbolTable* src) {
+    int idOffset = dst->idCounter - 1;
+    int* keyMap = malloc(sizeof(int) * (src->keys.count ? src->keys.count : 1));
+    int ok = keyMap != NULL;
+    for (int k = 0; ok && k < src->keys.count; k++) {
+        // Keys src copied are freed with it
+        Slice key = internedSlice(&src->keys, k);
+        if (key.flags & SLICE_OWNED) key.flags = SLICE_TRANSIENT;
+        keyMap[k] = internSlice(&dst->keys, key);
+        if (keyMap[k] < 0) ok = 0;
+    }
+    for (int i = 0; ok && i < src->registry.count; i++) {
+        ok = mergeTable(dst, src->registry.tables[i], keyMap, idOffset);
+    }
+    if (!ok) {
+        j2r_report_error("Memory allocation failed", "mergeSymbolTable", NULL);
+    }
+    dst->idCounter += src->idCounter - 1;
+    free(keyMap);
+    freeSymbolTables(src);
+    return ok;
+}
+
+void freeSymbolTables(SymbolTable* st) {
+    TableRegistry* reg = &st->registry;
+    for (int i = 0; i < reg->count; i++) {
+        if (reg->tables[i]) freeTable(reg->tables[i]);
+    }
+    free(reg->tables);
+    free(reg->bySchema);
+    free(reg->byName);
+    freeInterner(&st->keys);
+    initSymbolTable(st);
+}
@@ -1,37 +1,150 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
+#include <stdint.h>
 #include "ast.h"
+#include "intern.h"
+
+typedef enum {
+    SCHEMA_OBJECT,      // Object rows, identified by their set of keys
+    SCHEMA_SCALAR_ARRAY // index/value rows of a scalar array, identified by its name
+} SchemaKind;
+
+typedef struct {
+    SchemaKind kind;
+    uint64_t hash;      // Order-independent hash of kind and key ids
+    int* keyIds;        // Interned key ids (sorted once owned by a Table)
+    int keyCount;
+} Schema;
+
+#define SCHEMA_INLINE_KEYS 64
+
+typedef enum {
+    VALUE_NULL,         // JSON null, or no value for this row
+    VALUE_INT,
+    VALUE_DOUBLE,
+    VALUE_BOOL,
+    VALUE_STRING,
+    VALUE_NUMBER        // JSON number, as the text of the input (see number.h)
+} ValueType;
+
+typedef union {
+    int64_t i;
+    double d;
+    int b;
+    Slice s;
+} CellData;
+
+typedef struct {
+    ValueType type;
+    CellData as;
+} Value;
 
 typedef struct {
-    char** keys;        // Array of key names
-    char** values;      // Array of corresponding values
-    int keyCount;       // Number of key-value pairs
-    int id;             // Primary key
-    int parentId;       // Foreign key to parent
-    char* tableName;    // Name of the table this row belongs to
-} Row;
+    int keyId;          // Interned column name
+    ValueType type;     // Type of every valid cell, unless types is set
+    CellData* cells;    // One cell per row
+    uint8_t* types;     // Per-cell ValueType, only once the column mixes types
+    uint64_t* valid;    // Bit r is set when row r holds a non-null value
+    int firstRow;       // Row that introduced the column
+} Column;
+
+// Strings and numbers are held as text, which the cell owns if the slice
+// says so.
+static inline int valueHasText(ValueType type) {
+    return type == VALUE_STRING || type == VALUE_NUMBER;
+}
+
+static inline Value nullValue(void) {
+    Value v;
+    v.type = VALUE_NULL;
+    return v;
+}
+
+static inline Value intValue(int64_t i) {
+    Value v;
+    v.type = VALUE_INT;
+    v.as.i = i;
+    return v;
+}
+
+// Nested objects and arrays leave an empty string in their parent's row.
+static inline Value placeholderValue(void) {
+    Value v;
+    v.type = VALUE_STRING;
+    v.as.s = sliceOf("");
+    return v;
+}
+
+// Returns the value of a cell, VALUE_NULL for rows without one.
+static inline Value columnValue(const Column* c, int row) {
+    Value v;
+    if (!(c->valid[row >> 6] & (1ULL << (row & 63)))) {
+        v.type = VALUE_NULL;
+        return v;
+    }
+    v.type = c->types ? (ValueType)c->types[row] : c->type;
+    v.as = c->cells[row];
+    return v;
+}
 
 typedef struct Table {
-    char* schemaKey;    // Unique key for objects with same structure
+    Schema schema;      // Shared structure of all rows in this table
     char* name;         // Table name (e.g., "orders", "items")
     char* parentName;   // Name of parent table for foreign key (e.g., "orders" for items.order_id)
-    Row** rows;         // Array of rows
-    int rowCount;       // Number of rows
-    int rowCap;         // Capacity of rows array
+    Column* columns;    // Columns in the order their keys were first seen
+    int columnCount;    // Number of columns
+    int columnCap;      // Capacity of columns
+    int* ids;           // Primary key of each row
+    int* parentIds;     // Foreign key to parent of each row
+    int rowCount;       // Number of rows; row r is slot r of every column
+    int rowCap;         // Capacity of ids, parentIds and each column
+    int serial;         // Position in table creation order
+    int rowsSpilled;    // Rows written out early and cleared (--stream); they come before row 0
+    struct CsvSpillRows* spill; // Where csv-writer.c keeps those rows, NULL if none
 } Table;
 
-#define MAX_TABLES 100
-extern Table* tables[MAX_TABLES];
-extern int tableCount;
-extern int idCounter;
+typedef struct {
+    Table** tables;     // Tables in creation order
+    int count;          // Number of tables
+    int cap;            // Capacity of tables
+    int* bySchema;      // Hash index on schema fingerprint
+    int* byName;        // Hash index on table name
+    uint32_t slotMask;  // Slots per index - 1 (power of two)
+} TableRegistry;
+
+// Everything one conversion produces. Key ids in schemas and columns
+// index into keys.
+typedef struct {
+    TableRegistry registry;
+    Interner keys;      // Column names
+    int idCounter;      // Next row id
+    int serialCounter;  // Next table serial, for findOrCreateTableAt() callers
+    int topLevelObjects; // Objects walked without a parent table
+} SymbolTable;
 
-void report_error(const char* message, const char* context, const char* node_type);
-char* generateSchemaKey(ASTNode* node);
-Table* findOrCreateTable(const char* schemaKey, const char* tableName, const char* parentName);
-void addRow(Table* t, Row* row);
-void walkAST(ASTNode* node, const char* parentTable, int parentId);
-void printSymbolTables();
-void freeSymbolTables();
+void initSymbolTable(SymbolTable* st);
+void j2r_report_error(const char* message, const char* context, const char* node_type);
+int generateSchema(SymbolTable* st, ASTNode* node, Schema* schema, int* idBuf, int idCap);
+int scalarArraySchema(SymbolTable* st, Slice name, Schema* schema, int* idBuf);
+void objectSchema(int* keyIds, int keyCount, Schema* schema);
+void freeSchema(Schema* schema, int* idBuf);
+Table* findTableByName(const TableRegistry* reg, const char* name);
+Table* findOrCreateTable(SymbolTable* st, const Schema* schema, const char* tableName, const char* parentName);
+Table* findOrCreateTableAt(SymbolTable* st, const Schema* schema, const char* tableName, const char* parentName, int serial);
+void sortTablesBySerial(SymbolTable* st);
+int addRow(Table* t, int id, int parentId);
+int setCell(Table* t, int row, int keyId, Value value, int hint);
+void addObjectRow(SymbolTable* st, Table* table, int id, int parentId, int seq,
+                  const int* keyIds, Value* values, int keyCount);
+Slice valueText(const Value* v, char* buf, size_t cap);
+void walkAST(SymbolTable* st, ASTNode* node, const Slice* parentTable, int parentId);
+void walkDocument(SymbolTable* st, ASTNode* root, int jobs);
+void printSymbolTables(const SymbolTable* st);
+void discardRowsFrom(SymbolTable* st, int firstId, int tableCount);
+void clearTableRows(Table* t);
+void clearRows(SymbolTable* st);
+int mergeSymbolTable(SymbolTable* dst, SymbolTable* src);
+void freeSymbolTables(SymbolTable* st);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,291 @@
+#include <stdint.h>
+#include <string.h>
+#include "utf8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+// Length of the sequence that lead byte c starts, 0 if it cannot start one.
+static int sequenceLength(unsigned char c) {
+    if (c < 0x80) return 1;
+    if (c < 0xC2) return 0;     // Continuation byte, or overlong two-byte lead
+    if (c < 0xE0) return 2;
+    if (c < 0xF0) return 3;
+    if (c < 0xF5) return 4;
+    return 0;
+}
+
+// Returns the offset of the first sequence of p[0..n) that is not well
+// formed (Unicode table 3-7), or n. With partialEnd set, a sequence cut
+// off by the end counts as well formed.
+static size_t scanSequences(const unsigned char* p, size_t n, int partialEnd) {
+    size_t i = 0;
+    while (i < n) {
+        if (i + 8 <= n) {
+            uint64_t w;
+            memcpy(&w, p + i, 8);
+            if (!(w & 0x8080808080808080ULL)) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        int len = sequenceLength(c);
+        if (!len) return i;
+        // The lead narrows the second byte, which rules out overlong
+        // forms, surrogates and code points above U+10FFFF
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (c == 0xE0) lo = 0xA0;
+        else if (c == 0xED) hi = 0x9F;
+        else if (c == 0xF0) lo = 0x90;
+        else if (c == 0xF4) hi = 0x8F;
+        for (int k = 1; k < len; k++) {
+            if (i + k >= n) return partialEnd ? n : i;
+            unsigned char b = p[i + k];
+            if (b < lo || b > hi) return i;
+            lo = 0x80;
+            hi = 0xBF;
+        }
+        i += (size_t)len;
+    }
+    return n;
+}
+
+size_t utf8Validate(const char* p, size_t n) {
+    return scanSequences((const unsigned char*)p, n, 0);
+}
+
+// An ASCII block is only wrong if the bytes before it end in a lead byte
+// that still waits for continuation bytes.
+static int cutOffBefore(const unsigned char* p) {
+    return p[-1] >= 0xC0 || p[-2] >= 0xE0 || p[-3] >= 0xF0;
+}
+
+static int blockScalar(const unsigned char* p) {
+    // Start from the sequence p[0] belongs to
+    int start = 0;
+    while (start > -3 && (p[start] & 0xC0) == 0x80) start--;
+    if ((p[start] & 0xC0) == 0x80) return 1;
+    if (start == 0 && cutOffBefore(p)) return 1;
+    size_t n = (size_t)(64 - start);
+    return scanSequences(p + start, n, 1) != n;
+}
+
+#ifdef UTF8_X86
+// Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per
+// Byte" (2021). Every byte is checked against the one, two and three
+// before it: three nibble lookups give a bit per error kind that the pair
+// (previous byte, byte) can show, and the bits only survive the AND where
+// all three agree. Third and fourth bytes of a sequence are the expected
+// exception to "two continuation bytes in a row", which is what the
+// saturating subtractions find.
+#define TOO_SHORT       0x01    // Lead not followed by a continuation
+#define TOO_LONG        0x02    // Continuation after ASCII
+#define OVERLONG_3      0x04
+#define TOO_LARGE       0x08    // Above U+10FFFF
+#define SURROGATE       0x10
+#define OVERLONG_2      0x20
+#define TOO_LARGE_1000  0x40
+#define OVERLONG_4      0x40
+#define TWO_CONTS       0x80    // Continuation after continuation
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+static const char byte1High[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    (char)(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4)
+};
+
+static const char byte1Low[16] = {
+    (char)(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+    (char)(CARRY | OVERLONG_2),
+    (char)CARRY,
+    (char)CARRY,
+    (char)(CARRY | TOO_LARGE),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (char)(CARRY | TOO_LARGE | TOO_LARGE_1000)
+};
+
+static const char byte2High[16] = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+    (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+    (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+    (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+__attribute__((target("sse4.2")))
+static int blockSse(const unsigned char* p) {
+    __m128i any = _mm_setzero_si128();
+    for (int i = 0; i < 64; i += 16) {
+        any = _mm_or_si128(any, _mm_loadu_si128((const __m128i*)(p + i)));
+    }
+    if (!_mm_movemask_epi8(any)) return cutOffBefore(p);
+
+    const __m128i t1 = _mm_loadu_si128((const __m128i*)byte1High);
+    const __m128i t2 = _mm_loadu_si128((const __m128i*)byte1Low);
+    const __m128i t3 = _mm_loadu_si128((const __m128i*)byte2High);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i error = _mm_setzero_si128();
+    for (int i = 0; i < 64; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i prev1 = _mm_loadu_si128((const __m128i*)(p + i - 1));
+        __m128i prev2 = _mm_loadu_si128((const __m128i*)(p + i - 2));
+        __m128i prev3 = _mm_loadu_si128((const __m128i*)(p + i - 3));
+        __m128i special = _mm_and_si128(
+            _mm_and_si128(_mm_shuffle_epi8(t1, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                          _mm_shuffle_epi8(t2, _mm_and_si128(prev1, nibble))),
+            _mm_shuffle_epi8(t3, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+        __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                                      _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80)));
+        must23 = _mm_and_si128(must23, _mm_set1_epi8((char)0x80));
+        error = _mm_or_si128(error, _mm_xor_si128(must23, special));
+    }
+    return !_mm_testz_si128(error, error);
+}
+
+__attribute__((target("avx2")))
+static int blockAvx2(const unsigned char* p) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    if (!_mm256_movemask_epi8(_mm256_or_si256(lo, hi))) return cutOffBefore(p);
+
+    const __m256i t1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)byte1High));
+    const __m256i t2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)byte1Low));
+    const __m256i t3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)byte2High));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i error = _mm256_setzero_si256();
+    for (int i = 0; i < 64; i += 32) {
+        __m256i in = i ? hi : lo;
+        __m256i prev1 = _mm256_loadu_si256((const __m256i*)(p + i - 1));
+        __m256i prev2 = _mm256_loadu_si256((const __m256i*)(p + i - 2));
+        __m256i prev3 = _mm256_loadu_si256((const __m256i*)(p + i - 3));
+        __m256i special = _mm256_and_si256(
+            _mm256_and_si256(_mm256_shuffle_epi8(t1, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                             _mm256_shuffle_epi8(t2, _mm256_and_si256(prev1, nibble))),
+            _mm256_shuffle_epi8(t3, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+        __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)),
+                                         _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80)));
+        must23 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+        error = _mm256_or_si256(error, _mm256_xor_si256(must23, special));
+    }
+    return !_mm256_testz_si256(error, error);
+}
+#endif
+
+Utf8BlockFn utf8PickBlockCheck(void) {
+#ifdef UTF8_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return blockAvx2;
+    if (__builtin_cpu_supports("sse4.2")) return blockSse;
+#endif
+    return blockScalar;
+}
+
+static int hex4(const char* p, const char* end, unsigned* out) {
+    if (end - p < 4) return 0;
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+        else return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+static char* encodeUtf8(unsigned cp, char* out) {
+    if (cp < 0x80) {
+        *out++ = (char)cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+// Decodes the escape after the backslash at p[-1]. Returns the input
+// position after it, or NULL if it is invalid. A high surrogate must be
+// followed by a low one; lone surrogates have no UTF-8 form.
+static const char* unescapeOne(const char* p, const char* end, char** out) {
+    if (p == end) return NULL;
+    switch (*p++) {
+        case '"': *(*out)++ = '"'; return p;
+        case '\\': *(*out)++ = '\\'; return p;
+        case '/': *(*out)++ = '/'; return p;
+        case 'b': *(*out)++ = '\b'; return p;
+        case 'f': *(*out)++ = '\f'; return p;
+        case 'n': *(*out)++ = '\n'; return p;
+        case 'r': *(*out)++ = '\r'; return p;
+        case 't': *(*out)++ = '\t'; return p;
+        case 'u': break;
+        default: return NULL;
+    }
+    unsigned cp;
+    if (!hex4(p, end, &cp)) return NULL;
+    p += 4;
+    if (cp >= 0xDC00 && cp <= 0xDFFF) return NULL;
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+        unsigned low;
+        if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !hex4(p + 2, end, &low) ||
+            low < 0xDC00 || low > 0xDFFF) {
+            return NULL;
+        }
+        p += 6;
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+    }
+    *out = encodeUtf8(cp, *out);
+    return p;
+}
+
+// The text between escapes is copied a run at a time; memchr() and
+// memcpy() go through it in vector-sized steps.
+long jsonUnescape(const char* src, size_t n, char* dst, size_t* errAt) {
+    const char* p = src;
+    const char* end = src + n;
+    char* out = dst;
+    for (;;) {
+        const char* backslash = memchr(p, '\\', (size_t)(end - p));
+        size_t run = (size_t)((backslash ? backslash : end) - p);
+        memcpy(out, p, run);
+        out += run;
+        if (!backslash) break;
+        p = unescapeOne(backslash + 1, end, &out);
+        if (!p) {
+            if (errAt) *errAt = (size_t)(backslash - src);
+            return -1;
+        }
+    }
+    return (long)(out - dst);
+}
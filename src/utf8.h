@@ -0,0 +1,26 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+
+// Checks one 64-byte block of the input together with the three bytes
+// before it (p[-3..-1] must be readable). Returns nonzero if the block
+// holds a byte that cannot be part of well-formed UTF-8 given what
+// precedes it. A sequence cut off at the end of the block is left to the
+// next block, or to utf8Validate() at the end of the input.
+typedef int (*Utf8BlockFn)(const unsigned char* p);
+
+Utf8BlockFn utf8PickBlockCheck(void);
+
+// Returns the offset of the first byte of p[0..n) that is not well-formed
+// UTF-8, or n if there is none.
+size_t utf8Validate(const char* p, size_t n);
+
+// Decodes the body of a JSON string (the bytes between its quotes) into
+// dst, which must have room for n bytes: escapes never decode to more
+// bytes than they take. \u escapes become UTF-8, surrogate pairs included.
+// Returns the decoded length, or -1 for an invalid escape, whose offset is
+// then stored in *errAt if errAt is not NULL.
+long jsonUnescape(const char* src, size_t n, char* dst, size_t* errAt);
+
+#endif
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Batch inputs that share a file name would be written to the same output
+# directory; they must be rejected before anything is converted.
+# Usage: tests/batch-names.sh path/to/json2relcsv
+
+bin=${1:-./json2relcsv}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+mkdir -p "$tmp/a" "$tmp/b" "$tmp/out"
+echo '{"name": "a"}' > "$tmp/a/x.json"
+echo '{"name": "b"}' > "$tmp/b/x.json"
+
+if "$bin" --batch "$tmp/a/x.json" "$tmp/b/x.json" --out-dir "$tmp/out" 2> "$tmp/err"; then
+    echo "FAIL: inputs sharing a file name were accepted"
+    exit 1
+fi
+if ! grep -q "would both be written to" "$tmp/err"; then
+    echo "FAIL: no error names the clashing inputs"
+    exit 1
+fi
+if [ -e "$tmp/out/x" ]; then
+    echo "FAIL: output was written before the clash was reported"
+    exit 1
+fi
+
+# Distinct names still convert, one directory each
+mv "$tmp/b/x.json" "$tmp/b/y.json"
+if ! "$bin" --batch "$tmp/a/x.json" "$tmp/b/y.json" --out-dir "$tmp/out" > /dev/null; then
+    echo "FAIL: inputs with distinct names were rejected"
+    exit 1
+fi
+if [ ! -f "$tmp/out/x/objects.csv" ] || [ ! -f "$tmp/out/y/objects.csv" ]; then
+    echo "FAIL: per-input directories were not written"
+    exit 1
+fi
+echo "PASS"
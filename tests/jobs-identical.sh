@@ -0,0 +1,54 @@
+#!/bin/sh
+# Large inputs are indexed in parallel byte ranges whose starting state is
+# guessed; the output must not depend on --jobs even when range
+# boundaries fall inside strings and escape sequences.
+# Usage: tests/jobs-identical.sh path/to/json2relcsv
+
+bin=${1:-./json2relcsv}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# About 8 MiB of records whose strings are mostly backslash runs of every
+# length, escaped quotes and structural characters, so that boundaries
+# every 64 bytes land in all the states the indexer can be in.
+awk 'BEGIN {
+    bs = "\\\\"
+    printf "["
+    for (i = 0; i < 8000; i++) {
+        s = ""
+        for (k = 0; k < 12; k++) {
+            run = ""
+            for (r = (i + k) % 9; r > 0; r--) run = run bs
+            s = s run "\\\"{[,:]}\\\"" bs "u00e9\\ud83d\\ude00 x" substr("abcdefghijklmnop", 1, (i * k) % 17)
+        }
+        if (i) printf ","
+        printf "{\"k\":%d,\"text\":\"%s\",\"tags\":[\"%s\",\"[{\\\"\"],\"n\":{\"v\":%d.5e-3}}", i, s, s, i
+    }
+    printf "]\n"
+}' > "$tmp/in.json"
+
+for mode in "" "--stream"; do
+    mkdir -p "$tmp/ref$mode"
+    if ! "$bin" "$tmp/in.json" $mode --jobs 1 --out-dir "$tmp/ref$mode" > /dev/null; then
+        echo "FAIL: conversion with --jobs 1 $mode failed"
+        exit 1
+    fi
+    for jobs in 2 3 4 7; do
+        rm -rf "$tmp/out" && mkdir -p "$tmp/out"
+        if ! "$bin" "$tmp/in.json" $mode --jobs $jobs --out-dir "$tmp/out" > /dev/null; then
+            echo "FAIL: conversion with --jobs $jobs $mode failed"
+            exit 1
+        fi
+        for f in "$tmp/ref$mode"/*.csv; do
+            if ! cmp -s "$f" "$tmp/out/${f##*/}"; then
+                echo "FAIL: ${f##*/} differs between --jobs 1 and --jobs $jobs $mode"
+                exit 1
+            fi
+        done
+        if [ "$(ls "$tmp/out" | wc -l)" -ne "$(ls "$tmp/ref$mode" | wc -l)" ]; then
+            echo "FAIL: --jobs $jobs $mode wrote a different set of files"
+            exit 1
+        fi
+    done
+done
+echo "PASS"
@@ -0,0 +1,78 @@
+#!/bin/sh
+# numberToDouble() must round exactly as strtod() does, including halfway
+# cases, subnormals and mantissas longer than the 19 digits that fit in
+# 64 bits. Compiles a small driver against src/number.c.
+# Usage: tests/number-double.sh [path/to/src] [cc]
+
+src=${1:-./src}
+cc=${2:-cc}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+cat > "$tmp/driver.c" <<'END'
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "number.h"
+
+static const char* const cases[] = {
+    // Halfway between two doubles: ties go to even
+    "9007199254740993", "9007199254740995", "-9007199254740993",
+    "9007199254740993.0000000000000000001", "9007199254740992.9999999999999999999",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "7.2057594037927933e16", "1e23", "8.988465674311579e307",
+    // Subnormals and the edges of the range
+    "4.9406564584124654e-324", "2.4703282292062328e-324", "2.4703282292062327e-324",
+    "2.2250738585072011e-308", "2.2250738585072012e-308", "2.2250738585072014e-308",
+    "1e-320", "-1e-320", "1.5e-323", "3e-324", "1e-400",
+    "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "1e400",
+    // 19 and more significant digits
+    "1234567890123456789", "12345678901234567890", "18446744073709551615",
+    "18446744073709551616", "123456789012345678901234567890",
+    "0.1234567890123456789012", "3.14159265358979323846264338327950288",
+    "0.000000000000000000000000000000000000001234567890123456789012345",
+    "99999999999999999999999999999999999999999999999999e-50",
+    "2.2250738585072011360574097967091319759348195463516456480234262e-308",
+    "0.1", "0.3", "100", "0", "-0", "5e-1", "1e0", "123456789e-9",
+};
+
+static int check(const char* text) {
+    double want = strtod(text, NULL);
+    double got = numberToDouble(text, strlen(text));
+    if (memcmp(&want, &got, sizeof(double)) != 0) {
+        printf("FAIL: %s gave %.17g, strtod gave %.17g\n", text, got, want);
+        return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ok &= check(cases[i]);
+    }
+    // Random mantissas of 1 to 40 digits over the whole exponent range
+    srand(1);
+    char text[96];
+    for (int i = 0; i < 200000 && ok; i++) {
+        int len = 1 + rand() % 40;
+        char* p = text;
+        *p++ = '1' + rand() % 9;
+        for (int k = 1; k < len; k++) *p++ = '0' + rand() % 10;
+        sprintf(p, "e%d", rand() % 700 - 360 - len);
+        ok &= check(text);
+    }
+    return ok ? 0 : 1;
+}
+END
+
+if ! "$cc" -O2 -I"$src" -o "$tmp/driver" "$tmp/driver.c" "$src/number.c" -pthread; then
+    echo "FAIL: could not build the driver"
+    exit 1
+fi
+if ! "$tmp/driver"; then
+    exit 1
+fi
+echo "PASS"
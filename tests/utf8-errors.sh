@@ -0,0 +1,67 @@
+#!/bin/sh
+# Strings must be valid UTF-8 and \u escapes must not leave a surrogate
+# unpaired. Each error names the line and column of the offending byte or
+# escape, whichever lexer path finds it.
+# Usage: tests/utf8-errors.sh path/to/json2relcsv
+
+bin=${1:-./json2relcsv}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+status=0
+
+# expect <message> <options>: converts $tmp/in.json, which must fail with
+# <message> on stderr
+expect() {
+    message=$1
+    shift
+    if "$bin" "$tmp/in.json" "$@" > /dev/null 2> "$tmp/err"; then
+        echo "FAIL: $(od -An -c "$tmp/in.json" | head -c 60) $* was accepted"
+        status=1
+    elif ! grep -qF "$message" "$tmp/err"; then
+        echo "FAIL: expected '$message' $*, got: $(head -n 1 "$tmp/err")"
+        status=1
+    fi
+}
+
+check() {
+    expect "$1"
+    expect "$1" --stream
+}
+
+printf '{"a":\n "x\377"}' > "$tmp/in.json"
+check "Invalid UTF-8 at line 2, col 4"
+printf '{"a": "\303("}' > "$tmp/in.json"
+check "Invalid UTF-8 at line 1, col 8"
+printf '{"a": "\300\257"}' > "$tmp/in.json"
+check "Invalid UTF-8 at line 1, col 8"
+printf '{"a":\n\n  "ab\355\240\200"}' > "$tmp/in.json"
+check "Invalid UTF-8 at line 3, col 6"
+printf '{"a": "\360\237\230"}' > "$tmp/in.json"
+check "Invalid UTF-8 at line 1, col 8"
+printf '{"a": "\\ud800"}' > "$tmp/in.json"
+check "Invalid escape '\\ud800\"' at line 1, col 8"
+printf '{"a":\n "x\\udc00y"}' > "$tmp/in.json"
+check "Invalid escape '\\udc00y\"' at line 2, col 4"
+printf '{"a": "\\ud800\\u0041"}' > "$tmp/in.json"
+check "Invalid escape '\\ud800\\u0041\"' at line 1, col 8"
+
+# Far past the first parallel index range
+{
+    printf '{"a":\n"'
+    head -c 3000000 /dev/zero | tr '\0' x
+    printf '\377"}'
+} > "$tmp/in.json"
+expect "Invalid UTF-8 at line 2, col 3000002" --jobs 3
+expect "Invalid UTF-8 at line 2, col 3000002" --stream --jobs 3
+
+# A valid pair and multi-byte characters are kept
+printf '{"a": "\\ud83d\\ude00 \303\251"}' > "$tmp/in.json"
+mkdir -p "$tmp/out"
+if ! "$bin" "$tmp/in.json" --out-dir "$tmp/out" > /dev/null ||
+   ! grep -q "$(printf '\360\237\230\200 \303\251')" "$tmp/out/objects.csv"; then
+    echo "FAIL: a surrogate pair or multi-byte character was not converted"
+    status=1
+fi
+
+[ $status -eq 0 ] && echo "PASS"
+exit $status